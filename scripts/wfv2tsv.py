@@ -0,0 +1,89 @@
+# Usage
+# Run:
+#   python3 wfv2tsv.py PREFIX [N ...]
+# It reads the wavefront information written by `wfmash -T PREFIX --tsv-bin`
+# (PREFIX.wfv and PREFIX.wfv.idx) and writes the TSV files that `wfmash -T PREFIX`
+# writes, for all the alignments or only the N-th ones:
+#   PREFIX0.tsv
+#   PREFIX1.tsv
+#   ...
+# The TSV files can then be plotted with wfplot.R.
+
+import struct
+import sys
+
+MAGIC = b'WFVCELL1'
+
+INFO_LINE = '# info: 0) mismatch, mash-distance > threshold; 1) mismatch, WFA-score >= max_score; 2) match, WFA-score < max_score\n'
+
+
+def read_varint(data, p):
+    x = 0
+    shift = 0
+    while True:
+        b = data[p]
+        p += 1
+        x |= (b & 0x7f) << shift
+        if not b & 0x80:
+            return x, p
+        shift += 7
+
+
+def read_string(data, p):
+    n, p = read_varint(data, p)
+    return data[p:p + n].decode(), p + n
+
+
+def unzigzag(x):
+    return (x >> 1) ^ -(x & 1)
+
+
+def to_tsv(data, fw):
+    p = 0
+    query_name, p = read_string(data, p)
+    query_start, p = read_varint(data, p)
+    query_end, p = read_varint(data, p)
+    target_name, p = read_string(data, p)
+    target_start, p = read_varint(data, p)
+    target_end, p = read_varint(data, p)
+
+    fw.write(f'# query_name={query_name}\n')
+    fw.write(f'# query_start={query_start}\n')
+    fw.write(f'# query_end={query_end}\n')
+    fw.write(f'# target_name={target_name}\n')
+    fw.write(f'# target_start={target_start}\n')
+    fw.write(f'# target_end={target_end}\n')
+    fw.write(INFO_LINE)
+    fw.write('v\th\tinfo\n')
+
+    # each cell is a delta from the previous one, unless flagged as absolute
+    v = h = 0
+    while p < len(data):
+        a, p = read_varint(data, p)
+        b, p = read_varint(data, p)
+        if a & 4:
+            v = a >> 3
+            h = b
+        else:
+            v += unzigzag(a >> 3)
+            h += unzigzag(b)
+        fw.write(f'{v}\t{h}\t{a & 3}\n')
+
+
+if __name__ == '__main__':
+    prefix = sys.argv[1]
+
+    with open(prefix + '.wfv.idx', 'rb') as f:
+        index = f.read()
+    entries = [struct.unpack_from('<QQ', index, 16 * n) for n in range(len(index) // 16)]
+
+    selected = [int(n) for n in sys.argv[2:]] if len(sys.argv) > 2 else range(len(entries))
+
+    with open(prefix + '.wfv', 'rb') as f:
+        if f.read(len(MAGIC)) != MAGIC:
+            sys.exit(f'{prefix}.wfv is not a wfmash wavefront container')
+        for n in selected:
+            offset, length = entries[n]
+            f.seek(offset)
+            with open(f'{prefix}{n}.tsv', 'w') as fw:
+                to_tsv(f.read(length), fw)
@@ -0,0 +1,292 @@
+/**
+ * @file    align_cache.hpp
+ * @brief   on-disk cache of the alignments of mappings, so that runs over
+ *          mostly unchanged mappings only align the new ones
+ */
+
+#ifndef ALIGN_CACHE_HPP
+#define ALIGN_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+//External includes
+#include "common/murmur3.h"
+#include "common/wflign/src/wflign_wfa.hpp"
+
+namespace align
+{
+  /**
+   * @brief   alignments keyed by the mapped sequences, their coordinates and the
+   *          alignment parameters; the output options are not part of the key,
+   *          the cached alignments are formatted again for each run
+   *
+   *          The cache is a directory of segment files (*.wfc). Every run appends
+   *          to a segment of its own, so that runs (e.g. the shards of a job) can
+   *          share the directory, and reads all the segments found when it starts.
+   *          A record cut short by a killed run is ignored.
+   */
+  class alignment_cache_t {
+  public:
+      struct key_t {
+          uint64_t h[2];
+          bool operator==(const key_t& other) const {
+              return h[0] == other.h[0] && h[1] == other.h[1];
+          }
+      };
+
+      /**
+       * @brief                 key of the alignment of a mapping
+       * @param[in] query       query region, on the strand of the mapping
+       * @param[in] target      target region and the flanks the alignment may patch into
+       * @param[in] params      coordinates of the mapping and alignment parameters
+       */
+      static key_t key(const char* query, const uint64_t& query_length,
+                       const char* target, const uint64_t& target_length,
+                       const std::string& params) {
+          uint64_t parts[4];
+          MurmurHash3_x64_128(query, query_length, 42, parts);
+          MurmurHash3_x64_128(target, target_length, 42, parts + 2);
+          std::string buffer(reinterpret_cast<const char*>(parts), sizeof(parts));
+          buffer.append(format_version, sizeof(format_version));
+          buffer.append(params);
+          key_t k;
+          MurmurHash3_x64_128(buffer.data(), buffer.size(), 42, k.h);
+          return k;
+      }
+
+      explicit alignment_cache_t(const std::string& dirName)
+          : dirName(dirName) {
+          if (::mkdir(dirName.c_str(), 0755) != 0 && errno != EEXIST) {
+              fail("could not create " + dirName);
+          }
+          load();
+          segmentName = dirName + "/" + std::to_string(::time(nullptr))
+                  + "-" + std::to_string(::getpid()) + ".wfc";
+          fd = ::open(segmentName.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+          if (fd < 0) {
+              fail("could not create " + segmentName);
+          }
+          segments.push_back(fd);
+          write_all(format_version, sizeof(format_version));
+          size = sizeof(format_version);
+      }
+
+      ~alignment_cache_t() {
+          for (auto& s : segments) {
+              ::close(s);
+          }
+          // nothing new was aligned
+          if (size == sizeof(format_version)) {
+              ::unlink(segmentName.c_str());
+          }
+      }
+
+      uint64_t num_loaded() const { return loaded; }
+      uint64_t num_hits() const { return hits.load(); }
+      uint64_t num_misses() const { return misses.load(); }
+
+      // fetch the alignment with this key, if cached
+      bool get(const key_t& k, wflign::wavefront::merged_alignment_t& aln) {
+          location_t loc;
+          {
+              std::lock_guard<std::mutex> guard(mutex);
+              auto f = index.find(k);
+              if (f == index.end()) {
+                  ++misses;
+                  return false;
+              }
+              loc = f->second;
+          }
+          std::string payload(loc.length, '\0');
+          if (::pread(segments[loc.segment], &payload[0], loc.length, loc.offset) != (ssize_t) loc.length
+              || !decode(payload, aln)) {
+              ++misses;
+              return false;
+          }
+          ++hits;
+          return true;
+      }
+
+      // store the alignment with this key
+      void put(const key_t& k, const wflign::wavefront::merged_alignment_t& aln) {
+          std::string record(reinterpret_cast<const char*>(k.h), sizeof(k.h));
+          const std::string payload = encode(aln);
+          const uint32_t length = payload.size();
+          record.append(reinterpret_cast<const char*>(&length), sizeof(length));
+          record.append(payload);
+
+          std::lock_guard<std::mutex> guard(mutex);
+          write_all(record.data(), record.size());
+          index[k] = {segments.size() - 1, size + sizeof(k.h) + sizeof(length), length};
+          size += record.size();
+      }
+
+  private:
+      // changed whenever the alignments or the encoding change, to drop stale entries
+      static constexpr char format_version[8] = {'W', 'F', 'C', 'A', 'C', 'H', 'E', '1'};
+
+      struct key_hash_t {
+          std::size_t operator()(const key_t& k) const { return k.h[0]; }
+      };
+      struct location_t {
+          std::size_t segment;
+          uint64_t offset;
+          uint32_t length;
+      };
+
+      std::string dirName;
+      std::string segmentName;      // our segment
+      std::vector<int> segments;    // read descriptors of the segments; ours is the last
+      int fd = -1;                  // our segment
+      uint64_t size = 0;            // size of our segment
+      std::unordered_map<key_t, location_t, key_hash_t> index;
+      std::mutex mutex;
+      uint64_t loaded = 0;
+      std::atomic<uint64_t> hits{0};
+      std::atomic<uint64_t> misses{0};
+
+      // index the records of the segments already in the directory
+      void load() {
+          DIR* dir = ::opendir(dirName.c_str());
+          if (dir == nullptr) {
+              fail("could not open " + dirName);
+          }
+          while (struct dirent* entry = ::readdir(dir)) {
+              const std::string name = entry->d_name;
+              if (name.size() < 4 || name.compare(name.size() - 4, 4, ".wfc") != 0) {
+                  continue;
+              }
+              const int segment = ::open((dirName + "/" + name).c_str(), O_RDONLY);
+              struct stat st;
+              char version[sizeof(format_version)];
+              if (segment < 0 || ::fstat(segment, &st) != 0
+                  || ::pread(segment, version, sizeof(version), 0) != (ssize_t) sizeof(version)
+                  || std::memcmp(version, format_version, sizeof(version)) != 0) {
+                  if (segment >= 0) {
+                      ::close(segment);
+                  }
+                  continue;
+              }
+              segments.push_back(segment);
+              uint64_t offset = sizeof(format_version);
+              key_t k;
+              uint32_t length;
+              char header[sizeof(k.h) + sizeof(length)];
+              while (offset + sizeof(header) <= (uint64_t) st.st_size
+                     && ::pread(segment, header, sizeof(header), offset) == (ssize_t) sizeof(header)) {
+                  std::memcpy(k.h, header, sizeof(k.h));
+                  std::memcpy(&length, header + sizeof(k.h), sizeof(length));
+                  offset += sizeof(header);
+                  if (offset + length > (uint64_t) st.st_size) {
+                      break;
+                  }
+                  index[k] = {segments.size() - 1, offset, length};
+                  ++loaded;
+                  offset += length;
+              }
+          }
+          ::closedir(dir);
+      }
+
+      template<typename T>
+      static void put_value(std::string& s, const T& v) {
+          s.append(reinterpret_cast<const char*>(&v), sizeof(T));
+      }
+
+      template<typename T>
+      static bool get_value(const std::string& s, std::size_t& p, T& v) {
+          if (p + sizeof(T) > s.size()) {
+              return false;
+          }
+          std::memcpy(&v, s.data() + p, sizeof(T));
+          p += sizeof(T);
+          return true;
+      }
+
+      // fixed-width fields in native byte order, then the runs of the trace
+      static std::string encode(const wflign::wavefront::merged_alignment_t& aln) {
+          std::string s;
+          put_value(s, (uint8_t) aln.emitted);
+          put_value(s, aln.query_start);
+          put_value(s, aln.query_end);
+          put_value(s, aln.target_start);
+          put_value(s, aln.target_end);
+          put_value(s, (int64_t) aln.elapsed_time_wflambda_ms);
+          put_value(s, (int64_t) aln.elapsed_time_patching_ms);
+          put_value(s, aln.num_alignments);
+          put_value(s, aln.num_alignments_performed);
+          put_value(s, (uint64_t) aln.tracev.runs().size());
+          for (const auto& run : aln.tracev.runs()) {
+              put_value(s, run.op);
+              put_value(s, run.len);
+          }
+          return s;
+      }
+
+      static bool decode(const std::string& s, wflign::wavefront::merged_alignment_t& aln) {
+          std::size_t p = 0;
+          uint8_t emitted;
+          int64_t wt, pt;
+          uint64_t num_runs;
+          if (!(get_value(s, p, emitted)
+                && get_value(s, p, aln.query_start)
+                && get_value(s, p, aln.query_end)
+                && get_value(s, p, aln.target_start)
+                && get_value(s, p, aln.target_end)
+                && get_value(s, p, wt)
+                && get_value(s, p, pt)
+                && get_value(s, p, aln.num_alignments)
+                && get_value(s, p, aln.num_alignments_performed)
+                && get_value(s, p, num_runs))) {
+              return false;
+          }
+          aln.emitted = emitted;
+          aln.elapsed_time_wflambda_ms = wt;
+          aln.elapsed_time_patching_ms = pt;
+          aln.tracev.clear();
+          for (uint64_t i = 0; i < num_runs; ++i) {
+              char op;
+              uint64_t len;
+              if (!get_value(s, p, op) || !get_value(s, p, len)) {
+                  return false;
+              }
+              aln.tracev.push_back(op, len);
+          }
+          return true;
+      }
+
+      void write_all(const char* p, std::size_t left) {
+          while (left > 0) {
+              ssize_t n = ::write(fd, p, left);
+              if (n < 0) {
+                  if (errno == EINTR) {
+                      continue;
+                  }
+                  fail("could not write to " + dirName);
+              }
+              p += n;
+              left -= n;
+          }
+      }
+
+      void fail(const std::string& msg) {
+          std::cerr << "[wfmash] ERROR, align::alignment_cache_t, " << msg
+                    << ": " << std::strerror(errno) << std::endl;
+          exit(1);
+      }
+  };
+}
+
+#endif
@@ -0,0 +1,229 @@
+/**
+ * @file    align_journal.hpp
+ * @brief   journal of the mappings whose alignments are on disk, to resume
+ *          an interrupted align stage without redoing finished work
+ */
+
+#ifndef ALIGN_JOURNAL_HPP
+#define ALIGN_JOURNAL_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+//External includes
+#include "common/murmur3.h"
+
+namespace align
+{
+  /**
+   * @brief   append-only journal kept next to the output file (<output>.journal)
+   *
+   *          Each line holds the key of a mapping (hash of its PAF line) and the
+   *          size of the output file once its alignments were written; a line
+   *          starting with '#' marks where a run started appending. Entries are
+   *          only written once the output they refer to is on the storage device,
+   *          so on resume the output is cut back to the last entry, dropping
+   *          whatever a killed run left half-written. Entries past the end of
+   *          the output (lost to a crash despite that) are dropped as well.
+   *
+   *          The output is synced (and the journal appended) at most once per
+   *          sync_interval, so a crash loses up to that much of the alignments,
+   *          plus those still being aligned or waiting to be written in order:
+   *          those mappings are aligned again on resume.
+   */
+  class alignment_journal_t {
+  public:
+      static std::string journal_file(const std::string& outputFile) {
+          return outputFile + ".journal";
+      }
+
+      static bool exists(const std::string& outputFile) {
+          struct stat st;
+          return ::stat(journal_file(outputFile).c_str(), &st) == 0;
+      }
+
+      static constexpr std::chrono::seconds sync_interval{1};
+
+      // stable across runs and platforms
+      static uint64_t key(const std::string& mappingRecordLine) {
+          uint64_t h[2];
+          MurmurHash3_x64_128(mappingRecordLine.data(), mappingRecordLine.size(), 42, h);
+          return h[0];
+      }
+
+      /**
+       * @brief                 open the journal of outputFile, loading a previous one if present
+       * @param[in] outputFile  alignment output file (regular file)
+       */
+      explicit alignment_journal_t(const std::string& outputFile)
+          : outputFile(outputFile)
+          , fileName(journal_file(outputFile)) {
+          struct stat st;
+          const uint64_t output_size = ::stat(outputFile.c_str(), &st) == 0 ? st.st_size : 0;
+
+          uint64_t valid_bytes = 0;
+          uint64_t output_end = 0;
+          uint64_t dropped = 0;
+          const bool found = load(output_size, valid_bytes, output_end, dropped);
+          if (dropped > 0) {
+              std::cerr << "[wfmash::align] " << outputFile << " is shorter than recorded in " << fileName
+                        << ", dropping its last " << dropped << " entries" << std::endl;
+          }
+          if (found) {
+              // drop the output of the records that did not make it into the journal
+              if (output_size > output_end && ::truncate(outputFile.c_str(), output_end) != 0) {
+                  fail("could not truncate " + outputFile);
+              }
+          } else {
+              output_end = output_size;
+          }
+          base = output_end;
+
+          fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT, 0644);
+          if (fd < 0 || ::ftruncate(fd, valid_bytes) != 0 || ::lseek(fd, 0, SEEK_END) < 0) {
+              fail("could not open " + fileName);
+          }
+          pending_lines = "#\t" + std::to_string(base) + "\n";
+          write_pending();
+      }
+
+      ~alignment_journal_t() {
+          write_pending();
+          ::close(fd);
+      }
+
+      // number of mappings found completed in the previous runs
+      uint64_t num_completed() const { return completed_records; }
+
+      // consume one completion of the mapping with this key, if any is left
+      bool take_completed(const uint64_t& key) {
+          auto c = completed.find(key);
+          if (c == completed.end() || c->second == 0) {
+              return false;
+          }
+          --c->second;
+          return true;
+      }
+
+      /**
+       * @brief                 note that the mapping with this key is complete once the
+       *                        output is written up to output_bytes (from the start of this run)
+       */
+      void record(const uint64_t& key, const uint64_t& output_bytes) {
+          waiting.emplace_back(key, output_bytes);
+      }
+
+      /**
+       * @brief                     journal the records whose output is now written
+       * @param[in] written_bytes   output written so far (from the start of this run)
+       * @param[in] datasync        gets the written output onto the storage device,
+       *                            called before any entry refers to it
+       * @param[in] force           sync even if the last sync is less than sync_interval ago
+       */
+      template <typename Datasync>
+      void sync(const uint64_t& written_bytes, Datasync datasync, const bool& force = false) {
+          if (waiting.empty() || waiting.front().second > written_bytes) {
+              return;
+          }
+          const auto now = std::chrono::steady_clock::now();
+          if (!force && now - last_sync < sync_interval) {
+              return;
+          }
+          last_sync = now;
+          datasync();
+          std::size_t i = 0;
+          char line[64];
+          for (; i < waiting.size() && waiting[i].second <= written_bytes; ++i) {
+              snprintf(line, sizeof(line), "%016lx\t%lu\n",
+                       (unsigned long) waiting[i].first, (unsigned long) (base + waiting[i].second));
+              pending_lines.append(line);
+          }
+          waiting.erase(waiting.begin(), waiting.begin() + i);
+          write_pending();
+      }
+
+  private:
+      std::string outputFile;
+      std::string fileName;
+      int fd = -1;
+      uint64_t base = 0;                                     // output size when this run started
+      std::unordered_map<uint64_t, uint64_t> completed;      // key -> completions left to skip
+      uint64_t completed_records = 0;
+      std::vector<std::pair<uint64_t, uint64_t>> waiting;    // records whose output is not written yet
+      std::string pending_lines;
+      std::chrono::steady_clock::time_point last_sync;
+
+      // read the entries of a previous journal that the output (of output_size bytes) still
+      // holds; a last line without newline was cut by a kill
+      bool load(const uint64_t& output_size, uint64_t& valid_bytes, uint64_t& output_end, uint64_t& dropped) {
+          std::ifstream in(fileName);
+          if (!in.good()) {
+              return false;
+          }
+          std::stringstream buffer;
+          buffer << in.rdbuf();
+          const std::string contents = buffer.str();
+
+          bool found = false;
+          std::size_t begin = 0, end;
+          while ((end = contents.find('\n', begin)) != std::string::npos) {
+              const std::string line = contents.substr(begin, end - begin);
+              const auto tab = line.find('\t');
+              if (tab != std::string::npos) {
+                  const uint64_t line_end = std::stoull(line.substr(tab + 1));
+                  if (line_end > output_size) {
+                      // the output lost what this entry refers to: drop it and the ones after it
+                      for (std::size_t p = begin; (end = contents.find('\n', p)) != std::string::npos; p = end + 1) {
+                          dropped += contents[p] != '#';
+                      }
+                      break;
+                  }
+                  output_end = line_end;
+                  found = true;
+                  if (line[0] != '#') {
+                      ++completed[std::stoull(line.substr(0, tab), nullptr, 16)];
+                      ++completed_records;
+                  }
+              }
+              begin = end + 1;
+              valid_bytes = begin;
+          }
+          return found;
+      }
+
+      void write_pending() {
+          const char* p = pending_lines.data();
+          std::size_t left = pending_lines.size();
+          while (left > 0) {
+              ssize_t n = ::write(fd, p, left);
+              if (n < 0) {
+                  if (errno == EINTR) {
+                      continue;
+                  }
+                  fail("could not write to " + fileName);
+              }
+              p += n;
+              left -= n;
+          }
+          pending_lines.clear();
+      }
+
+      void fail(const std::string& msg) {
+          std::cerr << "[wfmash] ERROR, align::alignment_journal_t, " << msg
+                    << ": " << std::strerror(errno) << std::endl;
+          exit(1);
+      }
+  };
+}
+
+#endif
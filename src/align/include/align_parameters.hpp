@@ -15,6 +15,10 @@ namespace align {
 
 struct Parameters {
     int threads;                                  //execution thread count
+    uint64_t align_lookahead;                     //number of mappings reordered by estimated cost before being dispatched
+    uint64_t align_max_inflight_bytes;            //query and target bytes held by queued mappings, and bytes of their unwritten alignments, before the reader waits (0 for no limit)
+    uint64_t align_shard;                         //index of the shard of the mappings to align (0-based)
+    uint64_t align_shard_count;                   //number of cost-balanced shards the mappings are split into (1 for no sharding)
     //float percentageIdentity;                     //user defined threshold for good similarity
     float min_identity;                           // drop alignments below this identity threshold
     //int wf_min;                                   // minimum wavefront length to trigger WF_reduce wavefront pruning
@@ -37,6 +41,8 @@ struct Parameters {
     uint64_t wflign_max_len_major;
     uint64_t wflign_max_len_minor;
     uint16_t wflign_erode_k;
+    uint64_t wflign_chunk_length;                 //mappings at least twice this long are split in chunks aligned in parallel (0 to disable)
+    uint64_t wflign_max_memory;                   //memory budget of a single WFA alignment before going bidirectional (0 for no limit)
     int kmerSize;                                 //kmer size for pre-checking before aligning a fragment
 
     std::vector<std::string> refSequences;        //reference sequence(s)
@@ -44,9 +50,13 @@ struct Parameters {
     std::string mashmapPafFile;                   //mashmap paf mapping file
     std::string pafOutputFile;                    //paf/sam output file name
     std::string tsvOutputPrefix;                  //tsv files with wavefront information for each alignment
+    bool tsvContainer;                            //write the wavefront information to a single binary container instead
+    bool resume;                                  //journal the completed mappings and skip those of a previous run
+    std::string alignCacheDir;                    //directory of the alignment cache (empty for no cache)
 
     bool emit_md_tag;                             //Output the MD tag
     bool sam_format;                              //Emit the output in SAM format (PAF default)
+    bool bgzf_output;                             //Compress the output in BGZF blocks
 };
 
 }
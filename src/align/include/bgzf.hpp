@@ -0,0 +1,207 @@
+/**
+ * @file    bgzf.hpp
+ * @brief   parallel BGZF compression of the output stream
+ */
+
+#ifndef BGZF_HPP
+#define BGZF_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <zlib.h>
+
+namespace align
+{
+  /**
+   * @brief   cuts a byte stream into BGZF blocks (gzip members of at most 64 KiB,
+   *          as read by bgzip, tabix and htslib) and deflates them on a pool of
+   *          threads; the blocks come out in stream order
+   */
+  class bgzf_compressor_t {
+  public:
+      // uncompressed bytes per block, the same as bgzip
+      static constexpr std::size_t block_data_size = 0xff00;
+
+      bgzf_compressor_t(const int& num_threads, const int& level = Z_DEFAULT_COMPRESSION)
+          : level(level) {
+          for (int t = 0; t < std::max(1, num_threads); ++t) {
+              threads.emplace_back(&bgzf_compressor_t::compress_blocks, this);
+          }
+      }
+
+      ~bgzf_compressor_t() {
+          {
+              std::lock_guard<std::mutex> guard(mutex);
+              stopping = true;
+          }
+          todo_cv.notify_all();
+          for (auto& t : threads) {
+              t.join();
+          }
+      }
+
+      // the empty block that marks the end of a BGZF file
+      static std::string eof_block() {
+          static const unsigned char eof[28] = {
+              0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43,
+              0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+          return std::string(reinterpret_cast<const char*>(eof), sizeof(eof));
+      }
+
+      // add to the stream, handing over the blocks filled up
+      void append(const char* data, std::size_t n) {
+          while (n > 0) {
+              const std::size_t take = std::min(n, block_data_size - current.size());
+              current.append(data, take);
+              data += take;
+              n -= take;
+              if (current.size() == block_data_size) {
+                  submit();
+              }
+          }
+      }
+
+      // hand over the partial block, if any
+      void finish() {
+          if (!current.empty()) {
+              submit();
+          }
+      }
+
+      // blocks handed over and not yet collected
+      std::size_t pending() const { return blocks.size(); }
+
+      // move the compressed blocks that are ready, in order, to out; with wait, all of them
+      void collect(std::vector<std::string>& out, const bool& wait) {
+          std::unique_lock<std::mutex> lock(mutex);
+          while (!blocks.empty()) {
+              if (!blocks.front()->done) {
+                  if (!wait) {
+                      break;
+                  }
+                  done_cv.wait(lock, [&]() { return blocks.front()->done; });
+              }
+              out.push_back(std::move(blocks.front()->compressed));
+              blocks.pop_front();
+          }
+      }
+
+  private:
+      struct block_t {
+          std::string data;
+          std::string compressed;
+          bool done = false;
+      };
+
+      int level;
+      std::string current;
+      std::deque<std::shared_ptr<block_t>> blocks;   // in stream order
+      std::deque<std::shared_ptr<block_t>> todo;
+      std::vector<std::thread> threads;
+      std::mutex mutex;
+      std::condition_variable todo_cv;
+      std::condition_variable done_cv;
+      bool stopping = false;
+
+      void submit() {
+          auto block = std::make_shared<block_t>();
+          block->data.swap(current);
+          current.reserve(block_data_size);
+          {
+              std::lock_guard<std::mutex> guard(mutex);
+              blocks.push_back(block);
+              todo.push_back(block);
+          }
+          todo_cv.notify_one();
+      }
+
+      void compress_blocks() {
+          while (true) {
+              std::shared_ptr<block_t> block;
+              {
+                  std::unique_lock<std::mutex> lock(mutex);
+                  todo_cv.wait(lock, [&]() { return stopping || !todo.empty(); });
+                  if (todo.empty()) {
+                      return;
+                  }
+                  block = todo.front();
+                  todo.pop_front();
+              }
+              block->compressed = compress(block->data, level);
+              {
+                  std::lock_guard<std::mutex> guard(mutex);
+                  block->done = true;
+              }
+              done_cv.notify_all();
+          }
+      }
+
+      // a gzip member with the BC extra field holding its size
+      static std::string compress(const std::string& data, const int& level) {
+          static constexpr std::size_t header_size = 18;
+          static constexpr std::size_t footer_size = 8;
+          static constexpr std::size_t max_block_size = 0x10000;
+
+          std::string block(max_block_size, '\0');
+          auto* out = reinterpret_cast<unsigned char*>(&block[0]);
+          std::size_t deflated = deflate_raw(data, out + header_size,
+                                             max_block_size - header_size - footer_size, level);
+          if (deflated == 0) {
+              // incompressible: stored blocks always fit
+              deflated = deflate_raw(data, out + header_size,
+                                     max_block_size - header_size - footer_size, Z_NO_COMPRESSION);
+          }
+          if (deflated == 0) {
+              std::cerr << "[wfmash] ERROR, align::bgzf_compressor_t, could not compress a block" << std::endl;
+              exit(1);
+          }
+          const std::size_t size = header_size + deflated + footer_size;
+
+          static const unsigned char header[header_size - 2] = {
+              0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00};
+          std::memcpy(out, header, sizeof(header));
+          put_le(out + 16, size - 1, 2);
+          const uint32_t crc = crc32(crc32(0L, Z_NULL, 0),
+                                     reinterpret_cast<const Bytef*>(data.data()), data.size());
+          put_le(out + header_size + deflated, crc, 4);
+          put_le(out + header_size + deflated + 4, data.size(), 4);
+          block.resize(size);
+          return block;
+      }
+
+      // raw deflate of data into out; 0 if it does not fit
+      static std::size_t deflate_raw(const std::string& data, unsigned char* out,
+                                     const std::size_t& capacity, const int& level) {
+          z_stream zs;
+          std::memset(&zs, 0, sizeof(zs));
+          if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+              return 0;
+          }
+          zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+          zs.avail_in = data.size();
+          zs.next_out = out;
+          zs.avail_out = capacity;
+          const int status = deflate(&zs, Z_FINISH);
+          const std::size_t n = zs.total_out;
+          deflateEnd(&zs);
+          return status == Z_STREAM_END ? n : 0;
+      }
+
+      static void put_le(unsigned char* p, uint64_t v, const int& bytes) {
+          for (int i = 0; i < bytes; ++i) {
+              p[i] = v & 0xff;
+              v >>= 8;
+          }
+      }
+  };
+}
+
+#endif
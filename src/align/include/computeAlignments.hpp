@@ -15,11 +15,20 @@
 #include <zlib.h>
 #include <cassert>
 #include <thread>
+#include <chrono>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+#include <queue>
 
 //Own includes
 #include "align/include/align_types.hpp"
 #include "align/include/align_parameters.hpp"
+#include "align/include/output_buffer.hpp"
+#include "align/include/wavefront_container.hpp"
+#include "align/include/align_journal.hpp"
+#include "align/include/align_cache.hpp"
 #include "map/include/base_types.hpp"
 #include "map/include/commonFunc.hpp"
 
@@ -43,20 +52,86 @@ namespace align
         return p;
   }
 
+  /**
+   * @brief                         a query sequence and what the alignments of its mappings share,
+   *                                freed with the last of its mapping records
+   */
+  struct query_sequence_t {
+      std::string seq;
+      wflign::wavefront::segment_sketch_cache_t sketches;   // sketches of its segments, by forward position
+      // the bytes of the sequence (and of its reverse complement and sketches) are accounted in inflight_bytes
+      query_sequence_t(const std::string& s, std::atomic<uint64_t>& inflight_bytes)
+          : seq(s)
+          , sketches(&inflight_bytes)
+          , inflight_bytes(inflight_bytes)
+          { inflight_bytes += seq.size(); }
+      ~query_sequence_t() { inflight_bytes -= seq.size() + rev.size(); }
+      // built by the first mapping on the reverse strand
+      const std::string& reverseComplement() {
+          std::call_once(rev_once, [&]() {
+              rev.resize(seq.size());
+              skch::CommonFunc::reverseComplement(seq.c_str(), &rev[0], seq.size());
+              inflight_bytes += rev.size();
+          });
+          return rev;
+      }
+  private:
+      std::string rev;
+      std::once_flag rev_once;
+      std::atomic<uint64_t>& inflight_bytes;
+  };
+
   struct seq_record_t {
       MappingBoundaryRow currentRecord;
       std::string mappingRecordLine;
-      std::shared_ptr<std::string> qSequence;
-      seq_record_t(const MappingBoundaryRow& c, const std::string& r, const shared_ptr<std::string>& q)
+      std::shared_ptr<query_sequence_t> qSequence;
+      uint64_t id;                      // rank of the mapping in the input PAF
+      seq_record_t(const MappingBoundaryRow& c, const std::string& r, const shared_ptr<query_sequence_t>& q, const uint64_t& i)
           : currentRecord(c)
           , mappingRecordLine(r)
           , qSequence(q)
+          , id(i)
+          { }
+  };
+  struct paf_record_t {
+      uint64_t id;                      // rank of the originating mapping in the input PAF
+      uint64_t key;                     // journal key of the originating mapping
+      output_buffer_t* paf_lines;       // owned by the writer once pushed; may be empty
+      paf_record_t(const uint64_t& i, const uint64_t& k, output_buffer_t* p)
+          : id(i)
+          , key(k)
+          , paf_lines(p)
           { }
   };
   // load into this
   typedef atomic_queue::AtomicQueue<seq_record_t*, 2 << 16> seq_atomic_queue_t;
   // results into this, write out
-  typedef atomic_queue::AtomicQueue<std::string*, 2 << 16> paf_atomic_queue_t;
+  typedef atomic_queue::AtomicQueue<paf_record_t*, 2 << 16> paf_atomic_queue_t;
+  typedef atomic_queue::AtomicQueue<output_buffer_t*, 2 << 16> tsv_atomic_queue_t;
+
+  /**
+   * @brief                         estimate the relative cost of aligning a mapping
+   * @details                       WFA runs in O(n*s) time; s grows with the divergence and,
+   *                                in wflambda, each cell costs a segment-sized WFA.
+   *                                Only the ranking of the estimates matters.
+   * @param[in]   currentRecord
+   * @param[in]   segment_length    wflambda segment length
+   * @return                        estimated cost (arbitrary units)
+   */
+  inline double estimateAlignmentCost(const MappingBoundaryRow &currentRecord, const uint16_t &segment_length)
+  {
+      const uint64_t queryLen = currentRecord.qEndPos - currentRecord.qStartPos;
+      const uint64_t refLen = currentRecord.rEndPos - currentRecord.rStartPos;
+      const double len = std::max(queryLen, refLen);
+      const double divergence = std::max(0.001, 1.0 - (double)currentRecord.mashmap_estimated_identity);
+
+      // the pure WFA path is bounded in width by its adaptive reduction (4096 diagonals)
+      const double band = (queryLen <= MAX_LEN_FOR_PURE_WFA && refLen <= MAX_LEN_FOR_PURE_WFA)
+              ? std::min(len, 4096.0)
+              : (double)segment_length;
+
+      return len * (1.0 + band * divergence);
+  }
 
   /**
  * @brief                         parse mashmap row sequence
@@ -124,6 +199,20 @@ namespace align
 
       refSequenceMap_t refSequences;
 
+      //mappings of our shard (by line of the mashmap output), and what they need
+      std::vector<bool> shardMappings;
+      std::unordered_set<std::string> shardQueries;
+      std::unordered_set<std::string> shardTargets;
+      uint64_t shardAlignmentLength = 0;
+      uint64_t shardRecords = 0;
+
+      //completed mappings, when resuming
+      std::unique_ptr<alignment_journal_t> journal;
+
+      //alignments of previous runs, and the parameters that shape them (part of the cache keys)
+      std::unique_ptr<alignment_cache_t> cache;
+      std::string cacheParams;
+
     public:
 
       /**
@@ -133,7 +222,22 @@ namespace align
       explicit Aligner(const align::Parameters &p) :
         param(p)
       {
+        if (param.resume) {
+          journal.reset(new alignment_journal_t(param.pafOutputFile));
+        }
+        this->scanMappings();
         this->getRefSequences();
+        if (!param.alignCacheDir.empty()) {
+          cache.reset(new alignment_cache_t(param.alignCacheDir));
+          appendCacheParams(cacheParams, param.wflambda_segment_length, param.min_identity,
+                            param.wfa_mismatch_score, param.wfa_gap_opening_score, param.wfa_gap_extension_score,
+                            param.wflambda_min_wavefront_length, param.wflambda_max_distance_threshold,
+                            param.wflign_mismatch_score, param.wflign_gap_opening_score, param.wflign_gap_extension_score,
+                            param.wflign_max_mash_dist, param.wflign_max_len_major, param.wflign_max_len_minor,
+                            param.wflign_erode_k, param.wflign_chunk_length, param.wflign_max_memory);
+          std::cerr << "[wfmash::align] alignment cache " << param.alignCacheDir << ": "
+                    << cache->num_loaded() << " alignments" << std::endl;
+        }
       }
 
       /**
@@ -146,11 +250,106 @@ namespace align
 
     private:
 
+      // append the bytes of the values to a cache key
+      template<typename... T>
+      static void appendCacheParams(std::string& key, const T&... values)
+      {
+        (key.append(reinterpret_cast<const char*>(&values), sizeof(values)), ...);
+      }
+
+      /**
+       * @brief                 assign the mappings to cost-balanced shards and collect
+       *                        the query and target sequences needed by ours
+       */
+      void scanMappings()
+      {
+        std::vector<double> costs;
+        {
+          std::ifstream mappingListStream(param.mashmapPafFile);
+          std::string mappingRecordLine;
+          MappingBoundaryRow currentRecord;
+          while(std::getline(mappingListStream, mappingRecordLine))
+          {
+            if (mappingRecordLine.empty()) {
+              costs.push_back(-1);
+            } else {
+              parseMashmapRow(mappingRecordLine, currentRecord);
+              costs.push_back(estimateAlignmentCost(currentRecord, param.wflambda_segment_length));
+            }
+          }
+        }
+
+        // longest-processing-time-first: the most expensive mappings are placed
+        // first, each on the shard with the lowest total cost so far
+        shardMappings.assign(costs.size(), false);
+        if (param.align_shard_count <= 1) {
+          for (uint64_t i = 0; i < costs.size(); ++i) {
+            shardMappings[i] = costs[i] >= 0;
+          }
+        } else {
+          std::vector<uint64_t> order(costs.size());
+          for (uint64_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+          }
+          std::stable_sort(order.begin(), order.end(),
+                           [&](const uint64_t &a, const uint64_t &b) {
+                               return costs[a] > costs[b];
+                           });
+          typedef std::pair<double, uint64_t> shard_load_t;
+          std::priority_queue<shard_load_t, std::vector<shard_load_t>, std::greater<shard_load_t>> loads;
+          for (uint64_t i = 0; i < param.align_shard_count; ++i) {
+            loads.emplace(0.0, i);
+          }
+          for (const auto &i : order) {
+            if (costs[i] < 0) {
+              break;
+            }
+            auto load = loads.top();
+            loads.pop();
+            shardMappings[i] = load.second == param.align_shard;
+            load.first += costs[i];
+            loads.push(load);
+          }
+        }
+
+        std::ifstream mappingListStream(param.mashmapPafFile);
+        std::string mappingRecordLine;
+        MappingBoundaryRow currentRecord;
+        for (uint64_t i = 0; std::getline(mappingListStream, mappingRecordLine); ++i)
+        {
+          if (i < shardMappings.size() && shardMappings[i]
+              && journal && journal->take_completed(alignment_journal_t::key(mappingRecordLine))) {
+            // aligned by a previous run
+            shardMappings[i] = false;
+          }
+          if (i < shardMappings.size() && shardMappings[i]) {
+            parseMashmapRow(mappingRecordLine, currentRecord);
+            shardQueries.insert(currentRecord.qId);
+            shardTargets.insert(currentRecord.refId);
+            shardAlignmentLength += currentRecord.qEndPos - currentRecord.qStartPos;
+            ++shardRecords;
+          }
+        }
+
+        if (param.align_shard_count > 1) {
+          std::cerr << "[wfmash::align] shard " << param.align_shard << "/" << param.align_shard_count
+                    << ": " << shardRecords << " mappings, "
+                    << shardQueries.size() << " queries, "
+                    << shardTargets.size() << " targets" << std::endl;
+        }
+        if (journal) {
+          std::cerr << "[wfmash::align] resuming: " << journal->num_completed()
+                    << " mappings already aligned, " << shardRecords << " left" << std::endl;
+        }
+      }
+
       /**
-       * @brief                 parse and save all the reference sequences
+       * @brief                 parse and save the reference sequences hit by the mappings
        */
       void getRefSequences()
       {
+        // targets without mappings (in our shard) are never aligned against, so
+        // keeping them in memory would only grow the footprint of the align stage
         for(const auto &fileName : param.refSequences)
         {
 
@@ -160,6 +359,9 @@ namespace align
 
         seqiter::for_each_seq_in_file(
             fileName,
+            [&](const std::string& seq_name) {
+                return shardTargets.count(seq_name) != 0;
+            },
             [&](const std::string& seq_name,
                 const std::string& seq) {
                 // todo: offset_t is an 32-bit integer, which could cause problems
@@ -180,52 +382,22 @@ namespace align
       void computeAlignments()
       {
 
-          uint64_t total_seqs = 0;
-          uint64_t total_alignment_length = 0;
-          uint64_t total_paf_records = 0;
-          for(const auto &fileName : param.querySequences) {
-              std::ifstream mappingListStream(param.mashmapPafFile);
-              std::string mappingRecordLine;
-              MappingBoundaryRow currentRecord;
-              seqiter::for_each_seq_in_file(
-                  fileName,
-                  [&](const std::string& qSeqId,
-                      const std::string& _seq) {
-                      ++total_seqs;
-                      //total_seq_length += seq.size();
-                      while(!mappingListStream.eof() && mappingRecordLine.empty()) {
-                          std::getline(mappingListStream, mappingRecordLine);
-                      }
-
-                      if( !mappingRecordLine.empty() ) {
-                          parseMashmapRow(mappingRecordLine, currentRecord);
-
-                          if(currentRecord.qId == qSeqId) {
-                              //auto q = new seq_record_t(currentRecord, mappingRecordLine, seq);
-                              //seq_queue.push(q);
-                              total_alignment_length += currentRecord.qEndPos - currentRecord.qStartPos;
-                              ++total_paf_records;
-                              //Check if more mappings have same query sequence id
-                              while(std::getline(mappingListStream, mappingRecordLine)) {
-                                  parseMashmapRow(mappingRecordLine, currentRecord);
-                                  if(currentRecord.qId != qSeqId) {
-                                      break;
-                                  } else {
-                                      total_alignment_length += currentRecord.qEndPos - currentRecord.qStartPos;
-                                      ++total_paf_records;
-                                  }
-                              }
-                          }
-                      }
-                  });
-          }
+          // known from the scan of the mappings of our shard
+          const uint64_t total_seqs = shardQueries.size();
+          const uint64_t total_alignment_length = shardAlignmentLength;
 
           progress_meter::ProgressMeter progress(total_alignment_length, "[wfmash::align::computeAlignments] aligned");
 
+          // the parts of the alignments that split their work (long, chunked mappings,
+          // patches), picked up by the workers that are out of mappings
+          wflign::wavefront::task_pool_t task_pool;
+
           // input atomic queue
           seq_atomic_queue_t seq_queue;
-          // output atomic queues
-          paf_atomic_queue_t paf_queue, tsv_queue;
+          // output atomic queues, and the buffers that travel through them
+          paf_atomic_queue_t paf_queue;
+          tsv_atomic_queue_t tsv_queue;
+          output_buffer_pool_t buffer_pool;
           // flag when we're done reading
           std::atomic<bool> reader_done;
           reader_done.store(false);
@@ -238,9 +410,62 @@ namespace align
               w.store(true);
           }
 
+          // bytes of query sequence and target slices held by the mappings that are
+          // queued or being aligned, plus those of the alignments waiting in the
+          // writer for an earlier mapping to complete, and how many of those
+          // mappings there are
+          std::atomic<uint64_t> inflight_bytes(0);
+          std::atomic<uint64_t> inflight_records(0);
+          auto target_slice_bytes = [](const seq_record_t* rec) {
+              return (uint64_t)(rec->currentRecord.rEndPos - rec->currentRecord.rStartPos);
+          };
+
           // reader picks up candidate alignments from input
           auto reader_thread =
               [&]() {
+                  // look-ahead window: the most expensive mappings are dispatched first,
+                  // so that they do not end up running alone at the end of the job
+                  uint64_t num_records = 0;
+                  std::vector<seq_record_t*> window;
+                  window.reserve(param.align_lookahead);
+                  auto flush_window = [&]() {
+                      std::vector<std::pair<double, seq_record_t*>> by_cost;
+                      by_cost.reserve(window.size());
+                      for (auto* rec : window) {
+                          by_cost.emplace_back(estimateAlignmentCost(rec->currentRecord, param.wflambda_segment_length), rec);
+                      }
+                      std::stable_sort(by_cost.begin(), by_cost.end(),
+                                       [](const std::pair<double, seq_record_t*> &a, const std::pair<double, seq_record_t*> &b) {
+                                           return a.first > b.first;
+                                       });
+                      for (auto &p : by_cost) {
+                          seq_queue.push(p.second);
+                      }
+                      window.clear();
+                  };
+                  // past the memory budget, hand the window over and wait for the workers
+                  // to release enough; a mapping is always let through when nothing else
+                  // is in flight
+                  auto wait_for_budget = [&]() {
+                      if (param.align_max_inflight_bytes == 0
+                          || inflight_bytes.load() <= param.align_max_inflight_bytes) {
+                          return;
+                      }
+                      flush_window();
+                      while (inflight_bytes.load() > param.align_max_inflight_bytes
+                             && inflight_records.load() > 0) {
+                          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                      }
+                  };
+                  auto schedule = [&](seq_record_t* rec) {
+                      inflight_bytes += target_slice_bytes(rec);
+                      ++inflight_records;
+                      window.push_back(rec);
+                      if (window.size() >= param.align_lookahead) {
+                          flush_window();
+                      }
+                  };
+
                   //Parse query sequences
                   for(const auto &fileName : param.querySequences)
                   {
@@ -253,17 +478,35 @@ namespace align
                       std::ifstream mappingListStream(param.mashmapPafFile);
                       std::string mappingRecordLine;
                       MappingBoundaryRow currentRecord;
+                      // line of the mashmap output held in mappingRecordLine, to look up its shard
+                      uint64_t mappingRecordRank = 0;
+                      uint64_t nextMappingRecordRank = 0;
+                      auto nextMappingRecord = [&]() {
+                          mappingRecordRank = nextMappingRecordRank;
+                          if (std::getline(mappingListStream, mappingRecordLine)) {
+                              ++nextMappingRecordRank;
+                              return true;
+                          }
+                          return false;
+                      };
+                      auto inShard = [&]() {
+                          return mappingRecordRank < shardMappings.size() && shardMappings[mappingRecordRank];
+                      };
 
                       seqiter::for_each_seq_in_file(
                           fileName,
+                          [&](const std::string& qSeqId) {
+                              return shardQueries.count(qSeqId) != 0;
+                          },
                           [&](const std::string& qSeqId,
                               const std::string& _seq) {
+                              wait_for_budget();
                               // copy our input into a shared ptr
-                              std::shared_ptr<std::string> seq(new std::string(_seq));
+                              std::shared_ptr<query_sequence_t> seq(new query_sequence_t(_seq, inflight_bytes));
                               // todo: offset_t is an 32-bit integer, which could cause problems
-                              skch::offset_t len = seq->length();
+                              skch::offset_t len = seq->seq.length();
                               // upper-case our input and make sure it's canonical DNA (for WFA)
-                              skch::CommonFunc::makeUpperCaseAndValidDNA((char*)seq->c_str(), len);
+                              skch::CommonFunc::makeUpperCaseAndValidDNA((char*)seq->seq.c_str(), len);
                               // todo maybe this should change to some kind of unique pointer?
                               // something where we can GC it when we're done aligning to it
                               //std::string qSequence = seq;
@@ -272,21 +515,29 @@ namespace align
                               //Check if all mapping records are processed already
                               while(!mappingListStream.eof() && mappingRecordLine.empty()) {
                                   //Read first record from mashmap output file during first iteration
-                                  std::getline(mappingListStream, mappingRecordLine);
+                                  nextMappingRecord();
                               }
 
-                              if( !mappingRecordLine.empty() ) {
+                              //Skip the mappings of the queries that were not loaded (none is in our shard)
+                              while( !mappingRecordLine.empty() ) {
                                   parseMashmapRow(mappingRecordLine, currentRecord);
+                                  if (shardQueries.count(currentRecord.qId) != 0) {
+                                      break;
+                                  }
+                                  nextMappingRecord();
+                              }
 
+                              if( !mappingRecordLine.empty() ) {
                                   //Check if mapping query id matches current query sequence id
                                   if(currentRecord.qId == qSeqId)
                                   {
                                       //Queue up this query record
-                                      auto q = new seq_record_t(currentRecord, mappingRecordLine, seq);
-                                      seq_queue.push(q);
+                                      if (inShard()) {
+                                          schedule(new seq_record_t(currentRecord, mappingRecordLine, seq, num_records++));
+                                      }
 
                                       //Check if more mappings have same query sequence id
-                                      while(std::getline(mappingListStream, mappingRecordLine))
+                                      while(nextMappingRecord())
                                       {
                                           parseMashmapRow(mappingRecordLine, currentRecord);
 
@@ -295,10 +546,10 @@ namespace align
                                               //Break the inner loop to read query sequence
                                               break;
                                           }
-                                          else
+                                          else if (inShard())
                                           {
-                                              auto q = new seq_record_t(currentRecord, mappingRecordLine, seq);
-                                              seq_queue.push(q);
+                                              wait_for_budget();
+                                              schedule(new seq_record_t(currentRecord, mappingRecordLine, seq, num_records++));
                                           }
                                       }
                                   }
@@ -308,6 +559,7 @@ namespace align
                       mappingListStream.close();
 
                   }
+                  flush_window();
                   reader_done.store(true);
               };
 
@@ -321,41 +573,94 @@ namespace align
                   return ongoing;
               };
 
-          // writer, picks output from queue and writes it to our output stream
-          std::ofstream outstrm(param.pafOutputFile, ios::app);
+          // writer, picks output from queue and writes it to our output file
+          output_writer_t outstrm(param.pafOutputFile, buffer_pool, param.bgzf_output ? param.threads : 0);
 
+          // results arrive in completion order; they are written in input order
           auto writer_thread =
               [&]() {
+                  uint64_t next_id = 0;
+                  std::map<uint64_t, paf_record_t*> pending;
+                  // a mapping is journaled once its alignments are written out (and synced);
+                  // that happens at most once per sync interval, and once more at the end
+                  auto sync_journal = [&](const bool& force) {
+                      if (journal) {
+                          journal->sync(outstrm.bytes_written(), [&]() { outstrm.datasync(); }, force);
+                      }
+                  };
+                  auto write_pending = [&]() {
+                      auto p = pending.begin();
+                      while (p != pending.end() && p->first == next_id) {
+                          inflight_bytes -= p->second->paf_lines->size();
+                          outstrm.push(p->second->paf_lines);
+                          if (journal) {
+                              journal->record(p->second->key, outstrm.bytes_pushed());
+                          }
+                          delete p->second;
+                          p = pending.erase(p);
+                          ++next_id;
+                      }
+                      sync_journal(false);
+                  };
+                  auto add_pending = [&](paf_record_t* paf_rec) {
+                      pending.emplace(paf_rec->id, paf_rec);
+                      write_pending();
+                  };
                   while (true) {
-                      std::string* paf_lines = nullptr;
-                      if (!paf_queue.try_pop(paf_lines)
+                      paf_record_t* paf_rec = nullptr;
+                      if (!paf_queue.try_pop(paf_rec)
                           && !still_working(working)) {
                           break;
-                      } else if (paf_lines != nullptr) {
-                          outstrm << *paf_lines;
-                          delete paf_lines;
+                      } else if (paf_rec != nullptr) {
+                          add_pending(paf_rec);
                       } else {
+                          // nothing to do: get what we have onto disk
+                          outstrm.flush();
+                          sync_journal(false);
                           std::this_thread::sleep_for(100ns);
                       }
                   }
+                  // pick up what was pushed between the last pop and the workers' exit
+                  paf_record_t* paf_rec = nullptr;
+                  while (paf_queue.try_pop(paf_rec)) {
+                      add_pending(paf_rec);
+                  }
+                  outstrm.flush();
+                  sync_journal(true);
+                  assert(pending.empty());
               };
 
           uint64_t num_alignments_completed = 0;
           auto writer_thread_tsv =
                   [&]() {
               if (!param.tsvOutputPrefix.empty()) {
+                  // the wavefront information of the alignments, one after the other in
+                  // the container, or decoded into one TSV file per alignment
+                  std::unique_ptr<wavefront_container_writer_t> container;
+                  if (param.tsvContainer) {
+                      container.reset(new wavefront_container_writer_t(param.tsvOutputPrefix, buffer_pool));
+                  }
                   while (true) {
-                      std::string* tsv_lines = nullptr;
+                      output_buffer_t* tsv_lines = nullptr;
                       if (!tsv_queue.try_pop(tsv_lines)
                       && !still_working(working)) {
                           break;
                       } else if (tsv_lines != nullptr) {
-                          std::ofstream ofstream_tsv(param.tsvOutputPrefix + std::to_string(num_alignments_completed++) + ".tsv");
-                          ofstream_tsv << *tsv_lines;
-                          ofstream_tsv.close();
-
-                          delete tsv_lines;
+                          if (container) {
+                              container->push(tsv_lines);
+                              ++num_alignments_completed;
+                              continue;
+                          }
+                          output_buffer_t* tsv_text = buffer_pool.acquire();
+                          std::ostream tsv_text_stream(tsv_text);
+                          wflign::wavefront::wavefront_info_to_tsv(tsv_lines->data(), tsv_lines->size(), tsv_text_stream);
+                          buffer_pool.release(tsv_lines);
+                          output_writer_t ofstream_tsv(param.tsvOutputPrefix + std::to_string(num_alignments_completed++) + ".tsv", buffer_pool, 0, true);
+                          ofstream_tsv.push(tsv_text);
                       } else {
+                          if (container) {
+                              container->flush();
+                          }
                           std::this_thread::sleep_for(100ns);
                       }
                   }
@@ -373,34 +678,41 @@ namespace align
                           && reader_done.load()) {
                           break;
                       } else if (rec != nullptr) {
-                          std::stringstream output;
-                          std::stringstream output_tsv;
+                          // format straight into buffers that are handed over to the writers
+                          output_buffer_t* paf_lines = buffer_pool.acquire();
+                          output_buffer_t* tsv_lines = buffer_pool.acquire();
+                          std::ostream output(paf_lines);
+                          std::ostream output_tsv(tsv_lines);
                           doAlignment(output, output_tsv,
                                       rec->currentRecord,
                                       rec->mappingRecordLine,
-                                      rec->qSequence);
+                                      rec->qSequence,
+                                      task_pool);
                           progress.increment(rec->currentRecord.qEndPos - rec->currentRecord.qStartPos);
 
-                          auto* paf_rec = new std::string(output.str());
-                          if (!paf_rec->empty()) {
-                              paf_queue.push(paf_rec);
-                          } else {
-                              delete paf_rec;
-                          }
+                          // always push a record, even if empty, so that the writer can keep the input order;
+                          // its bytes count against the budget until it is written out
+                          inflight_bytes += paf_lines->size();
+                          paf_queue.push(new paf_record_t(rec->id,
+                                                          journal ? alignment_journal_t::key(rec->mappingRecordLine) : 0,
+                                                          paf_lines));
 
-                          auto* tsv_rec = new std::string(output_tsv.str());
-                          if (!tsv_rec->empty()) {
-                              tsv_queue.push(tsv_rec);
+                          if (!tsv_lines->empty()) {
+                              tsv_queue.push(tsv_lines);
                           } else {
-                              delete tsv_rec;
+                              buffer_pool.release(tsv_lines);
                           }
 
+                          inflight_bytes -= target_slice_bytes(rec);
                           delete rec;
-                      } else {
+                          --inflight_records;
+                      } else if (!task_pool.help()) {
                           std::this_thread::sleep_for(100ns);
                       }
                   }
                   is_working.store(false);
+                  // out of mappings: help the workers still aligning with their chunks and patches
+                  task_pool.help_until([&]() { return !still_working(working); });
               };
 
           // launch reader
@@ -427,6 +739,10 @@ namespace align
           writer_tsv.join();
 
           progress.finish();
+          if (cache) {
+              std::cerr << "[wfmash::align::computeAlignments] alignment cache: "
+                        << cache->num_hits() << " hits, " << cache->num_misses() << " misses" << std::endl;
+          }
           std::cerr << "[wfmash::align::computeAlignments] "
                     << "count of mapped reads = " << total_seqs
                     << ", total aligned bp = " << total_alignment_length << std::endl;
@@ -489,15 +805,17 @@ namespace align
        * @brief                           compute alignment using edlib 
        * @param[in]   currentRecord       mashmap mapping parsed information
        * @param[in]   mappingRecordLine   mashmap mapping output raw string
-       * @param[in]   qSequence           query sequence
+       * @param[in]   qSequence           query sequence (and what its mappings share)
+       * @param[in]   task_pool           helper threads shared by the alignments
        * @param[in]   outstrm             output stream
        */
       void doAlignment(
-              std::stringstream& output,
-              std::stringstream& output_tsv,
+              std::ostream& output,
+              std::ostream& output_tsv,
               MappingBoundaryRow &currentRecord,
               const std::string &mappingRecordLine,
-              const std::shared_ptr<std::string> &qSequence) {
+              const std::shared_ptr<query_sequence_t> &qSequence,
+              wflign::wavefront::task_pool_t &task_pool) {
 
 #ifdef DEBUG
         std::cerr << "INFO, align::Aligner::doAlignment, aligning mashmap record: " << mappingRecordLine << std::endl;
@@ -511,21 +829,49 @@ namespace align
         skch::offset_t refLen = currentRecord.rEndPos - currentRecord.rStartPos;
         assert(refLen <= refSize);
 
-        //Define query substring for this mapping
-        const char* queryRegion = qSequence->c_str();  //initially point to beginning
-        const auto& querySize = qSequence->size();
+        //Define query substring for this mapping, on the strand of the mapping
+        //(the reverse complement of the query is built once, by its first reverse mapping)
+        const auto& querySize = qSequence->seq.size();
         skch::offset_t queryLen = currentRecord.qEndPos - currentRecord.qStartPos;
-        queryRegion += currentRecord.qStartPos;
+        const char* queryRegionStrand = currentRecord.strand == skch::strnd::FWD
+            ? qSequence->seq.c_str() + currentRecord.qStartPos
+            : qSequence->reverseComplement().c_str() + (querySize - currentRecord.qEndPos);
 
-        char* queryRegionStrand = new char[queryLen+1];
+        assert(queryLen <= querySize);
 
-        if(currentRecord.strand == skch::strnd::FWD) {
-          strncpy(queryRegionStrand, queryRegion, queryLen);    //Copy the same string
-        } else {
-          skch::CommonFunc::reverseComplement(queryRegion, queryRegionStrand, queryLen); //Reverse complement
+        //Reuse a cached alignment (the TSV output needs the alignment to be computed)
+        const bool useCache = cache && param.tsvOutputPrefix.empty();
+        alignment_cache_t::key_t cacheKey;
+        if (useCache) {
+          const auto lookup_start = std::chrono::steady_clock::now();
+          // patching the ends of the alignment can read past the target region
+          const uint64_t flank = queryLen + MIN_WFA_PATCH_LENGTH;
+          const uint64_t flankBegin = currentRecord.rStartPos > flank ? currentRecord.rStartPos - flank : 0;
+          const uint64_t flankEnd = std::min((uint64_t)refSize, (uint64_t)currentRecord.rEndPos + flank);
+          std::string params = cacheParams;
+          appendCacheParams(params, currentRecord.qStartPos, currentRecord.qEndPos, currentRecord.strand,
+                            currentRecord.rStartPos, currentRecord.rEndPos, querySize, refSize,
+                            currentRecord.mashmap_estimated_identity);
+          cacheKey = alignment_cache_t::key(queryRegionStrand, queryLen,
+                                            this->refSequences[refId].c_str() + flankBegin, flankEnd - flankBegin,
+                                            params);
+
+          wflign::wavefront::merged_alignment_t aln;
+          if (cache->get(cacheKey, aln)) {
+            // the timings are this run's: the lookup took the place of the alignment
+            aln.elapsed_time_wflambda_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - lookup_start).count();
+            aln.elapsed_time_patching_ms = 0;
+            wflign::wavefront::write_merged_alignment_record(
+                output, aln, param.emit_md_tag, !param.sam_format,
+                queryRegionStrand, currentRecord.qId, querySize, currentRecord.qStartPos, queryLen,
+                currentRecord.strand != skch::strnd::FWD,
+                refRegion, refId, refSize, currentRecord.rStartPos,
+                param.min_identity, currentRecord.mashmap_estimated_identity);
+            return;
+          }
         }
-
-        assert(queryLen <= querySize);
+        wflign::wavefront::merged_alignment_t result;
 
         //Compute alignment
 #ifdef DEBUG
@@ -556,9 +902,16 @@ namespace align
             param.wflign_max_mash_dist,
             param.wflign_max_len_major,
             param.wflign_max_len_minor,
-            param.wflign_erode_k);
-
-        delete [] queryRegionStrand;
+            param.wflign_erode_k,
+            param.wflign_chunk_length,
+            param.wflign_max_memory,
+            &task_pool,
+            &qSequence->sketches,
+            useCache ? &result : nullptr);
+
+        if (useCache) {
+          cache->put(cacheKey, result);
+        }
       }
   };
 }
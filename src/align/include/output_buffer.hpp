@@ -0,0 +1,300 @@
+/**
+ * @file    output_buffer.hpp
+ * @brief   recycled output buffers handed from the alignment workers to the writer
+ */
+
+#ifndef OUTPUT_BUFFER_HPP
+#define OUTPUT_BUFFER_HPP
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <memory>
+
+//Own includes
+#include "align/include/bgzf.hpp"
+
+//External includes
+#include "common/atomic_queue/atomic_queue.h"
+
+namespace align
+{
+  /**
+   * @brief   growable in-memory stream buffer; a std::ostream formats straight into it,
+   *          and the writer takes the bytes from data()/size() without any copy
+   */
+  class output_buffer_t : public std::streambuf {
+  public:
+      output_buffer_t() {
+          buffer.resize(initial_capacity);
+          clear();
+      }
+
+      const char* data() const { return pbase(); }
+      std::size_t size() const { return pptr() - pbase(); }
+      std::size_t capacity() const { return buffer.size(); }
+      bool empty() const { return size() == 0; }
+
+      // drop the contents, keeping the allocation for the next record
+      void clear() {
+          setp(buffer.data(), buffer.data() + buffer.size());
+      }
+
+      // give back the allocation of an unusually large buffer
+      void shrink(const std::size_t& max_capacity) {
+          if (buffer.size() > max_capacity) {
+              std::vector<char>(initial_capacity).swap(buffer);
+          }
+          clear();
+      }
+
+  protected:
+      int_type overflow(int_type ch) override {
+          if (traits_type::eq_int_type(ch, traits_type::eof())) {
+              return traits_type::not_eof(ch);
+          }
+          grow(1);
+          *pptr() = traits_type::to_char_type(ch);
+          pbump(1);
+          return ch;
+      }
+
+      std::streamsize xsputn(const char* s, std::streamsize n) override {
+          if (epptr() - pptr() < n) {
+              grow(n);
+          }
+          std::memcpy(pptr(), s, n);
+          advance(n);
+          return n;
+      }
+
+  private:
+      static constexpr std::size_t initial_capacity = 4096;
+      std::vector<char> buffer;
+
+      // pbump takes an int, but a CIGAR can be longer than that
+      void advance(std::size_t n) {
+          while (n > (std::size_t) INT_MAX) {
+              pbump(INT_MAX);
+              n -= INT_MAX;
+          }
+          pbump((int) n);
+      }
+
+      // make room for at least n more bytes
+      void grow(const std::size_t& n) {
+          const std::size_t used = size();
+          std::size_t new_capacity = buffer.size() * 2;
+          while (new_capacity < used + n) {
+              new_capacity *= 2;
+          }
+          buffer.resize(new_capacity);
+          setp(buffer.data(), buffer.data() + buffer.size());
+          advance(used);
+      }
+  };
+
+  /**
+   * @brief   free list of output buffers; workers acquire, the writer releases
+   *          once the contents are on disk
+   */
+  class output_buffer_pool_t {
+  public:
+      ~output_buffer_pool_t() {
+          output_buffer_t* buf = nullptr;
+          while (free_list.try_pop(buf)) {
+              delete buf;
+          }
+      }
+
+      output_buffer_t* acquire() {
+          output_buffer_t* buf = nullptr;
+          if (!free_list.try_pop(buf)) {
+              buf = new output_buffer_t();
+          }
+          return buf;
+      }
+
+      void release(output_buffer_t* buf) {
+          if (buf == nullptr) {
+              return;
+          }
+          buf->shrink(max_retained_capacity);
+          if (!free_list.try_push(buf)) {
+              delete buf;
+          }
+      }
+
+  private:
+      // buffers that grew past this are reallocated rather than kept around
+      static constexpr std::size_t max_retained_capacity = 64 << 20;
+      atomic_queue::AtomicQueue<output_buffer_t*, 1024> free_list;
+  };
+
+  /**
+   * @brief   appends output buffers to a file descriptor, gathering them into
+   *          as few writev calls as possible; with compression threads, the
+   *          output is written as BGZF blocks compressed on those threads.
+   *          The file is appended to (it may hold a header, or a resumed run's
+   *          output), unless truncate is set for a freshly created file
+   */
+  class output_writer_t {
+  public:
+      output_writer_t(const std::string& fileName, output_buffer_pool_t& pool,
+                      const int& compression_threads = 0, const bool& truncate = false)
+          : fileName(fileName)
+          , pool(pool) {
+          fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | (truncate ? O_TRUNC : O_APPEND), 0644);
+          if (fd < 0) {
+              std::cerr << "ERROR, align::output_writer_t, Could not open " << fileName << std::endl;
+              exit(1);
+          }
+          if (compression_threads > 0) {
+              bgzf.reset(new bgzf_compressor_t(compression_threads));
+          }
+      }
+
+      ~output_writer_t() {
+          flush();
+          if (bgzf) {
+              bgzf->finish();
+              write_blocks(true);
+              const std::string eof = bgzf_compressor_t::eof_block();
+              std::vector<struct iovec> iov(1);
+              iov[0].iov_base = const_cast<char*>(eof.data());
+              iov[0].iov_len = eof.size();
+              write_all(iov);
+          }
+          ::close(fd);
+      }
+
+      // queue a buffer for writing; it is returned to the pool once written
+      void push(output_buffer_t* buf) {
+          if (buf->empty()) {
+              pool.release(buf);
+              return;
+          }
+          if (bgzf) {
+              bgzf->append(buf->data(), buf->size());
+              pushed_bytes += buf->size();
+              pool.release(buf);
+              // don't let the compression fall too far behind
+              write_blocks(bgzf->pending() >= max_pending_blocks);
+              return;
+          }
+          batch.push_back(buf);
+          batch_bytes += buf->size();
+          pushed_bytes += buf->size();
+          if (batch.size() == max_batch_buffers || batch_bytes >= max_batch_bytes) {
+              flush();
+          }
+      }
+
+      // write out everything queued so far (the compressed blocks that are ready)
+      void flush() {
+          if (bgzf) {
+              write_blocks(false);
+              return;
+          }
+          if (batch.empty()) {
+              return;
+          }
+          std::vector<struct iovec> iov(batch.size());
+          for (std::size_t i = 0; i < batch.size(); ++i) {
+              iov[i].iov_base = const_cast<char*>(batch[i]->data());
+              iov[i].iov_len = batch[i]->size();
+          }
+          write_all(iov);
+          written_bytes += batch_bytes;
+          for (auto* buf : batch) {
+              pool.release(buf);
+          }
+          batch.clear();
+          batch_bytes = 0;
+      }
+
+      // get what is written so far onto the storage device
+      void datasync() {
+          if (synced_bytes == written_bytes) {
+              return;
+          }
+          if (::fdatasync(fd) != 0) {
+              std::cerr << "ERROR, align::output_writer_t, Could not sync " << fileName
+                        << ": " << std::strerror(errno) << std::endl;
+              exit(1);
+          }
+          synced_bytes = written_bytes;
+      }
+
+      // bytes handed over so far, and how many of them are already written
+      uint64_t bytes_pushed() const { return pushed_bytes; }
+      uint64_t bytes_written() const { return written_bytes; }
+
+  private:
+      static constexpr std::size_t max_batch_buffers = 512;   // below the usual IOV_MAX of 1024
+      static constexpr std::size_t max_batch_bytes = 16 << 20;
+      static constexpr std::size_t max_pending_blocks = 256;
+
+      std::string fileName;
+      int fd;
+      output_buffer_pool_t& pool;
+      std::vector<output_buffer_t*> batch;
+      std::size_t batch_bytes = 0;
+      uint64_t pushed_bytes = 0;
+      uint64_t written_bytes = 0;
+      uint64_t synced_bytes = 0;
+      std::unique_ptr<bgzf_compressor_t> bgzf;
+
+      // write the compressed blocks that are ready; with wait, all the blocks handed over
+      void write_blocks(const bool& wait) {
+          std::vector<std::string> blocks;
+          bgzf->collect(blocks, wait);
+          for (std::size_t first = 0; first < blocks.size(); first += max_batch_buffers) {
+              const std::size_t count = std::min(max_batch_buffers, blocks.size() - first);
+              std::vector<struct iovec> iov(count);
+              for (std::size_t i = 0; i < count; ++i) {
+                  iov[i].iov_base = const_cast<char*>(blocks[first + i].data());
+                  iov[i].iov_len = blocks[first + i].size();
+              }
+              write_all(iov);
+          }
+      }
+
+      void write_all(std::vector<struct iovec>& iov) {
+          // writev may write less than asked for (pipes, signals): resume where it stopped
+          struct iovec* first = iov.data();
+          int count = iov.size();
+          while (count > 0) {
+              ssize_t n = ::writev(fd, first, count);
+              if (n < 0) {
+                  if (errno == EINTR) {
+                      continue;
+                  }
+                  std::cerr << "ERROR, align::output_writer_t, Could not write to " << fileName
+                            << ": " << std::strerror(errno) << std::endl;
+                  exit(1);
+              }
+              while (count > 0 && (std::size_t) n >= first->iov_len) {
+                  n -= first->iov_len;
+                  ++first;
+                  --count;
+              }
+              if (count > 0) {
+                  first->iov_base = static_cast<char*>(first->iov_base) + n;
+                  first->iov_len -= n;
+              }
+          }
+      }
+  };
+}
+
+#endif
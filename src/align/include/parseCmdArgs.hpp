@@ -168,6 +168,17 @@ $ mashmap-align -s ref.fa -q seq.fq --mappingFile mashmap.out --pi 80 [OPTIONS]"
 
     str.clear();
 
+    parameters.align_lookahead = 4096;
+    parameters.align_max_inflight_bytes = 0;
+    parameters.align_shard = 0;
+    parameters.align_shard_count = 1;
+    parameters.resume = false;
+    parameters.bgzf_output = false;
+    parameters.tsvContainer = false;
+    parameters.alignCacheDir = "";
+    parameters.wflign_chunk_length = 0;
+    parameters.wflign_max_memory = 0;
+
     if(cmd.foundOption("output"))
     {
       str << cmd.optionValue("output");
@@ -0,0 +1,82 @@
+/**
+ * @file    wavefront_container.hpp
+ * @brief   single append-only file for the wavefront information (-T) of all
+ *          the alignments, instead of one TSV file per alignment
+ */
+
+#ifndef WAVEFRONT_CONTAINER_HPP
+#define WAVEFRONT_CONTAINER_HPP
+
+#include <string>
+#include <ostream>
+#include <cstdint>
+
+//Own includes
+#include "align/include/output_buffer.hpp"
+
+namespace align
+{
+  /**
+   * @brief   PREFIX.wfv holds an 8-byte magic, then the wavefront information of
+   *          the alignments (as encoded by wflign::wavefront::wavefront_info_encoder_t)
+   *          one after the other; PREFIX.wfv.idx holds, for the n-th alignment,
+   *          its offset and length in PREFIX.wfv (two little-endian uint64).
+   *          The n-th alignment is the one that went to PREFIXn.tsv before;
+   *          scripts/wfv2tsv.py writes those TSV files back.
+   */
+  class wavefront_container_writer_t {
+  public:
+      static constexpr char magic[8] = {'W', 'F', 'V', 'C', 'E', 'L', 'L', '1'};
+
+      wavefront_container_writer_t(const std::string& prefix, output_buffer_pool_t& pool)
+          : pool(pool)
+          , data(prefix + ".wfv", pool, 0, true)
+          , index(prefix + ".wfv.idx", pool, 0, true) {
+          output_buffer_t* header = pool.acquire();
+          std::ostream(header).write(magic, sizeof(magic));
+          data.push(header);
+      }
+
+      ~wavefront_container_writer_t() {
+          // an index entry never points past the data on disk
+          flush();
+      }
+
+      // append the wavefront information of the next alignment
+      void push(output_buffer_t* info) {
+          output_buffer_t* entry = pool.acquire();
+          std::ostream entry_stream(entry);
+          put_le(entry_stream, offset);
+          put_le(entry_stream, info->size());
+          offset += info->size();
+          if (info->empty()) {
+              pool.release(info);
+          } else {
+              data.push(info);
+          }
+          index.push(entry);
+      }
+
+      void flush() {
+          data.flush();
+          index.flush();
+      }
+
+  private:
+      output_buffer_pool_t& pool;
+      output_writer_t data;
+      output_writer_t index;
+      uint64_t offset = sizeof(magic);
+
+      static void put_le(std::ostream& out, uint64_t v) {
+          char bytes[8];
+          for (int i = 0; i < 8; ++i) {
+              bytes[i] = v & 0xff;
+              v >>= 8;
+          }
+          out.write(bytes, sizeof(bytes));
+      }
+  };
+}
+
+#endif
@@ -6,8 +6,11 @@
 
 namespace seqiter {
 
+// call func on the sequences of the file whose name passes keep; the others
+// are skipped without being stored
 void for_each_seq_in_file(
     const std::string& filename,
+    const std::function<bool(const std::string&)>& keep,
     const std::function<void(const std::string&, const std::string&)>& func) {
     // detect file type
     bool input_is_fasta = false;
@@ -27,16 +30,19 @@ void for_each_seq_in_file(
     if (input_is_fasta) {
         while (in.good()) {
             std::string name = line.substr(1, line.find(" ")-1);
+            const bool kept = keep(name);
             std::string seq;
             while (std::getline(in, line)) {
                 if (line[0] == '>') {
                     // this is the header of the next sequence
                     break;
-                } else {
+                } else if (kept) {
                     seq.append(line);
                 }
             }
-            func(name, seq);
+            if (kept) {
+                func(name, seq);
+            }
         }
     } else if (input_is_fastq) {
         while (in.good()) {
@@ -46,9 +52,17 @@ void for_each_seq_in_file(
             std::getline(in, line); // delimiter
             std::getline(in, line); // quality
             std::getline(in, line); // next header
-            func(name, seq);
+            if (keep(name)) {
+                func(name, seq);
+            }
         }
     }
 }
 
+void for_each_seq_in_file(
+    const std::string& filename,
+    const std::function<void(const std::string&, const std::string&)>& func) {
+    for_each_seq_in_file(filename, [](const std::string&) { return true; }, func);
+}
+
 }
@@ -47,6 +47,8 @@
 #include "gap_affine2p/affine2p_dp.h"
 
 #include "wavefront/wavefront_align.h"
+#include "wavefront/wavefront_extend.h"
+#include "wavefront/wavefront_compute_affine.h"
 
 /*
  * Algorithms
@@ -102,6 +104,8 @@ typedef struct {
   profiler_timer_t timer_global;
   // System
   uint64_t max_memory;
+  wf_extend_kernel_t extend_kernel;
+  wf_compute_kernel_t compute_kernel;
   int progress;
   bool verbose;
 } benchmark_args;
@@ -153,6 +157,8 @@ benchmark_args parameters = {
   .plot = 0,
   // System
   .max_memory = UINT64_MAX,
+  .extend_kernel = wf_extend_kernel_auto,
+  .compute_kernel = wf_compute_kernel_auto,
   .progress = 10000,
   .verbose = false
 };
@@ -414,6 +420,8 @@ void align_benchmark_print_results(
   // Print benchmark results
   fprintf(stderr,"[Benchmark]\n");
   fprintf(stderr,"=> Total.reads            %d\n",seqs_processed);
+  fprintf(stderr,"=> Extend.kernel          %s\n",wavefront_extend_get_kernel_name());
+  fprintf(stderr,"=> Compute.kernel         %s\n",wavefront_compute_affine_get_kernel_name());
   fprintf(stderr,"=> Time.Benchmark      ");
   timer_print(stderr,&parameters.timer_global,NULL);
   fprintf(stderr,"  => Time.Alignment    ");
@@ -568,6 +576,8 @@ void usage() {
       "          --plot                                                     \n"
       "        [System]                                                     \n"
       "          --max-memory <bytes>                                       \n"
+      "          --extend-kernel 'auto'|'scalar'|'avx2'|'avx512'            \n"
+      "          --compute-kernel 'auto'|'scalar'|'avx2'|'avx512'           \n"
       "          --progress|P <integer>                                     \n"
       "          --help|h                                                   \n");
 }
@@ -594,6 +604,8 @@ void parse_arguments(int argc,char** argv) {
     { "plot", optional_argument, 0, 2003 },
     /* System */
     { "max-memory", required_argument, 0, 3000 },
+    { "extend-kernel", required_argument, 0, 3001 },
+    { "compute-kernel", required_argument, 0, 3002 },
     { "progress", required_argument, 0, 'P' },
     { "verbose", no_argument, 0, 'v' },
     { "help", no_argument, 0, 'h' },
@@ -788,6 +800,34 @@ void parse_arguments(int argc,char** argv) {
     case 3000:
       parameters.max_memory = atol(optarg);
       break;
+    case 3001: // --extend-kernel
+      if (strcasecmp(optarg,"auto")==0) {
+        parameters.extend_kernel = wf_extend_kernel_auto;
+      } else if (strcasecmp(optarg,"scalar")==0) {
+        parameters.extend_kernel = wf_extend_kernel_scalar;
+      } else if (strcasecmp(optarg,"avx2")==0) {
+        parameters.extend_kernel = wf_extend_kernel_avx2;
+      } else if (strcasecmp(optarg,"avx512")==0) {
+        parameters.extend_kernel = wf_extend_kernel_avx512;
+      } else {
+        fprintf(stderr,"Option '--extend-kernel' must be in {'auto','scalar','avx2','avx512'}\n");
+        exit(1);
+      }
+      break;
+    case 3002: // --compute-kernel
+      if (strcasecmp(optarg,"auto")==0) {
+        parameters.compute_kernel = wf_compute_kernel_auto;
+      } else if (strcasecmp(optarg,"scalar")==0) {
+        parameters.compute_kernel = wf_compute_kernel_scalar;
+      } else if (strcasecmp(optarg,"avx2")==0) {
+        parameters.compute_kernel = wf_compute_kernel_avx2;
+      } else if (strcasecmp(optarg,"avx512")==0) {
+        parameters.compute_kernel = wf_compute_kernel_avx512;
+      } else {
+        fprintf(stderr,"Option '--compute-kernel' must be in {'auto','scalar','avx2','avx512'}\n");
+        exit(1);
+      }
+      break;
     case 'P':
       parameters.progress = atoi(optarg);
       break;
@@ -827,6 +867,8 @@ void parse_arguments(int argc,char** argv) {
 int main(int argc,char* argv[]) {
   // Parsing command-line options
   parse_arguments(argc,argv);
+  wavefront_extend_set_kernel(parameters.extend_kernel);
+  wavefront_compute_affine_set_kernel(parameters.compute_kernel);
   // Select option
   if (parameters.algorithm == alignment_test) {
     align_pairwise_test();
@@ -36,6 +36,7 @@
 #include "WFA/wavefront/wavefront_compute_affine.h"
 #include "WFA/wavefront/wavefront_compute_affine2p.h"
 #include "WFA/wavefront/wavefront_backtrace.h"
+#include "WFA/wavefront/wavefront_bialign.h"
 
 #ifdef WFA_NAMESPACE
 namespace wfa {
@@ -162,7 +163,7 @@ bool wavefront_align_end2end_terminate(
           &wf_aligner->cigar);
     } else {
       // Backtrace alignment
-      wavefront_backtrace_affine(wf_aligner,score,alignment_k,alignment_offset);
+      wavefront_backtrace_affine(wf_aligner,affine2p_matrix_M,score,alignment_k,alignment_offset);
     }
   }
   // Set score & finish
@@ -254,7 +255,7 @@ bool wavefront_align_endsfree_terminate(
           &wf_aligner->cigar);
     } else {
       // Backtrace alignment
-      wavefront_backtrace_affine(wf_aligner,score,alignment_k,alignment_offset);
+      wavefront_backtrace_affine(wf_aligner,affine2p_matrix_M,score,alignment_k,alignment_offset);
     }
   }
   // Set score & finish
@@ -314,6 +315,11 @@ int wavefront_align(
     const int pattern_length,
     const char* const text,
     const int text_length) {
+  // Bidirectional (linear memory)
+  if (wf_aligner->bidirectional &&
+      wf_aligner->alignment_form.span == alignment_end2end) {
+    return wavefront_bialign(wf_aligner,pattern,pattern_length,text,text_length);
+  }
   // Resize wavefront aligner
   wavefront_aligner_resize(wf_aligner,pattern_length,text_length);
   // Init padded strings
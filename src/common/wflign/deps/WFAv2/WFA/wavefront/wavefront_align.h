@@ -42,6 +42,22 @@ namespace wfa {
 #define WF_ALIGN_MAX_SCORE   -1
 #define WF_ALIGN_OOM         -2
 
+/*
+ * Initialization & Termination
+ */
+void wavefront_align_end2end_initialize(
+    wavefront_aligner_t* const wf_aligner);
+bool wavefront_align_end2end_terminate(
+    wavefront_aligner_t* const wf_aligner,
+    const int score_final);
+
+/*
+ * Limits
+ */
+int wavefront_align_reached_limits(
+    wavefront_aligner_t* const wf_aligner,
+    const int score);
+
 /*
  * Wavefront Alignment
  */
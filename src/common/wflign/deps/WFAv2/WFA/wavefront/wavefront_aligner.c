@@ -33,6 +33,7 @@
 #include "WFA/wavefront/wavefront_reduction.h"
 #include "WFA/wavefront/wavefront_components.h"
 #include "WFA/wavefront/wavefront_plot.h"
+#include "WFA/wavefront/wavefront_bialign.h"
 
 #ifdef WFA_NAMESPACE
 namespace wfa {
@@ -136,6 +137,9 @@ wavefront_aligner_t* wavefront_aligner_new(
   wavefront_components_allocate(
       &wf_aligner->wf_components,pattern_length,text_length,
       &wf_aligner->penalties,memory_modular,bt_piggyback,mm_allocator);
+  // Bidirectional
+  wf_aligner->bidirectional = attributes->bidirectional;
+  wf_aligner->bialigner = NULL;
   // CIGAR
   cigar_allocate(&wf_aligner->cigar,2*(pattern_length+text_length),mm_allocator);
   // Display
@@ -198,6 +202,8 @@ void wavefront_aligner_delete(
   mm_allocator_t* const mm_allocator = wf_aligner->mm_allocator;
   // Wavefront components
   wavefront_components_free(&wf_aligner->wf_components);
+  // Bidirectional
+  if (wf_aligner->bialigner != NULL) wavefront_bialigner_delete(wf_aligner->bialigner);
   // CIGAR
   cigar_free(&wf_aligner->cigar);
   // Slab
@@ -251,6 +257,11 @@ void wavefront_aligner_set_max_memory_used(
     const uint64_t max_memory_used) {
   wf_aligner->system.max_memory_used = max_memory_used;
 }
+void wavefront_aligner_set_bidirectional(
+    wavefront_aligner_t* const wf_aligner,
+    const bool bidirectional) {
+  wf_aligner->bidirectional = bidirectional;
+}
 /*
  * Utils
  */
@@ -63,6 +63,9 @@ typedef struct _wavefront_aligner_t {
   wavefront_reduction_t reduction;             // Reduction parameters
   // Wavefront components
   wavefront_components_t wf_components;        // Wavefront components
+  // Bidirectional
+  bool bidirectional;                          // Align bidirectionally (linear memory)
+  struct _wavefront_bialigner_t* bialigner;    // Bidirectional aligner (allocated on first use)
   // CIGAR
   cigar_t cigar;                               // Alignment CIGAR
   // MM
@@ -115,6 +118,9 @@ void wavefront_aligner_set_max_alignment_score(
 void wavefront_aligner_set_max_memory_used(
     wavefront_aligner_t* const wf_aligner,
     const uint64_t max_memory_used);
+void wavefront_aligner_set_bidirectional(
+    wavefront_aligner_t* const wf_aligner,
+    const bool bidirectional);
 
 /*
  * Utils
@@ -80,6 +80,7 @@ wavefront_aligner_attr_t wavefront_aligner_attr_default = {
     },
     // Memory model
     .low_memory = false,
+    .bidirectional = false,
     // MM
     .mm_allocator = NULL, // Use private MM
     // Display
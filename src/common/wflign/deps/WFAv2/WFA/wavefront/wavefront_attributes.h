@@ -104,6 +104,7 @@ typedef struct {
   wavefront_reduction_t reduction;           // Wavefront reduction
   // Memory model
   bool low_memory;                           // Use low-memory strategy (modular wavefronts and piggyback)
+  bool bidirectional;                        // Use bidirectional WFA (linear memory; end-to-end gap-affine only)
   // External MM (instead of allocating one inside)
   mm_allocator_t* mm_allocator;              // MM-Allocator
   // Display
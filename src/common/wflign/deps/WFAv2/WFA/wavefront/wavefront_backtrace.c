@@ -266,6 +266,7 @@ void wavefront_backtrace_lineal(
 }
 void wavefront_backtrace_affine(
     wavefront_aligner_t* const wf_aligner,
+    const affine2p_matrix_type component_end,
     const int alignment_score,
     const int alignment_k,
     const wf_offset_t alignment_offset) {
@@ -276,7 +277,7 @@ void wavefront_backtrace_affine(
   const wavefronts_penalties_t* const wavefront_penalties = &(wf_aligner->penalties);
   cigar_t* const cigar = &wf_aligner->cigar;
   // Set starting location
-  affine2p_matrix_type matrix_type = affine2p_matrix_M;
+  affine2p_matrix_type matrix_type = component_end;
   int score = alignment_score;
   int k = alignment_k;
   int h = WAVEFRONT_H(k,alignment_offset);
@@ -32,6 +32,7 @@
 #pragma once
 
 #include "WFA/wavefront/wavefront_aligner.h"
+#include "WFA/gap_affine2p/affine2p_matrix.h"
 
 #ifdef WFA_NAMESPACE
 namespace wfa {
@@ -39,9 +40,12 @@ namespace wfa {
 
 /*
  * Backtrace
+ *   Traces back from the component_end wavefront (affine2p_matrix_M for a
+ *   regular alignment)
  */
 void wavefront_backtrace_affine(
     wavefront_aligner_t* const wf_aligner,
+    const affine2p_matrix_type component_end,
     const int alignment_score,
     const int alignment_k,
     const wf_offset_t alignment_offset);
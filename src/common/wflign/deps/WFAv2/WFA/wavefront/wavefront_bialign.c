@@ -0,0 +1,482 @@
+/*
+ *                             The MIT License
+ *
+ * Wavefront Alignments Algorithms
+ * Copyright (c) 2017 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ * This file is part of Wavefront Alignments Algorithms.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * DESCRIPTION: Bidirectional WFA
+ */
+
+#include "WFA/utils/string_padded.h"
+#include "WFA/wavefront/wavefront_bialign.h"
+#include "WFA/wavefront/wavefront_align.h"
+#include "WFA/wavefront/wavefront_extend.h"
+#include "WFA/wavefront/wavefront_compute_affine.h"
+#include "WFA/wavefront/wavefront_backtrace.h"
+
+#ifdef WFA_NAMESPACE
+namespace wfa {
+#endif
+
+/*
+ * Breakpoint
+ */
+typedef struct {
+  int score;                      // Combined score (forward + reverse)
+  int score_forward;              // Score of the forward part
+  int score_reverse;              // Score of the reverse part
+  int k_forward;                  // Breakpoint diagonal (forward)
+  wf_offset_t offset_forward;     // Breakpoint offset (forward)
+  affine2p_matrix_type component; // Component both parts meet in (M/I1/D1)
+} wf_bialign_breakpoint_t;
+
+/*
+ * Setup
+ */
+wavefront_aligner_t* wavefront_bialigner_new_aligner(
+    wavefront_aligner_t* const wf_aligner,
+    const alignment_scope_t alignment_scope,
+    const bool low_memory) {
+  wavefront_aligner_attr_t attributes = wavefront_aligner_attr_default;
+  attributes.distance_metric = gap_affine;
+  attributes.affine_penalties.match = 0;
+  attributes.affine_penalties.mismatch = wf_aligner->penalties.mismatch;
+  attributes.affine_penalties.gap_opening = wf_aligner->penalties.gap_opening1;
+  attributes.affine_penalties.gap_extension = wf_aligner->penalties.gap_extension1;
+  attributes.alignment_scope = alignment_scope;
+  attributes.low_memory = low_memory;
+  attributes.reduction.reduction_strategy = wavefront_reduction_none;
+  return wavefront_aligner_new(&attributes);
+}
+wavefront_bialigner_t* wavefront_bialigner_new(
+    wavefront_aligner_t* const wf_aligner) {
+  wavefront_bialigner_t* const wf_bialigner =
+      mm_allocator_alloc(wf_aligner->mm_allocator,wavefront_bialigner_t);
+  wf_bialigner->mm_allocator = wf_aligner->mm_allocator;
+  wf_bialigner->alg_forward = wavefront_bialigner_new_aligner(wf_aligner,compute_score,false);
+  wf_bialigner->alg_reverse = wavefront_bialigner_new_aligner(wf_aligner,compute_score,false);
+  wf_bialigner->alg_subsidiary = wavefront_bialigner_new_aligner(wf_aligner,compute_alignment,false);
+  return wf_bialigner;
+}
+void wavefront_bialigner_delete(
+    wavefront_bialigner_t* const wf_bialigner) {
+  wavefront_aligner_delete(wf_bialigner->alg_forward);
+  wavefront_aligner_delete(wf_bialigner->alg_reverse);
+  wavefront_aligner_delete(wf_bialigner->alg_subsidiary);
+  mm_allocator_free(wf_bialigner->mm_allocator,wf_bialigner);
+}
+/*
+ * Initialization
+ *   A subproblem may begin with the continuation of a gap opened before it (it
+ *   starts from M and from that gap, at no cost) and may have to end with a
+ *   gap that continues after it (on the reversed sequences, it starts from that
+ *   gap alone, so the opening of the gap is not counted)
+ */
+void wavefront_bialign_initialize_component(
+    wavefront_aligner_t* const alg,
+    const affine2p_matrix_type component,
+    const bool component_only) {
+  wavefront_components_t* const wf_components = &alg->wf_components;
+  wavefront_align_end2end_initialize(alg);
+  if (component == affine2p_matrix_M) return;
+  wavefront_t* const wavefront = wavefront_slab_allocate(alg->wavefront_slab,0,0);
+  wavefront->offsets[0] = 0;
+  if (component == affine2p_matrix_I1) {
+    wf_components->i1wavefronts[0] = wavefront;
+  } else {
+    wf_components->d1wavefronts[0] = wavefront;
+  }
+  if (component_only) {
+    wavefront_slab_free(alg->wavefront_slab,wf_components->mwavefronts[0]);
+    wf_components->mwavefronts[0] = NULL;
+  }
+}
+strings_padded_t* wavefront_bialign_initialize(
+    wavefront_aligner_t* const alg,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const affine2p_matrix_type component,
+    const bool component_only) {
+  wavefront_aligner_resize(alg,pattern_length,text_length);
+  strings_padded_t* const sequences =
+      strings_padded_new_rhomb(
+          pattern,pattern_length,text,text_length,
+          WAVEFRONT_PADDING,alg->mm_allocator);
+  alg->pattern = sequences->pattern_padded;
+  alg->text = sequences->text_padded;
+  wavefront_bialign_initialize_component(alg,component,component_only);
+  wavefront_extend_end2end(alg,0);
+  return sequences;
+}
+/*
+ * Score-only wavefronts
+ */
+void wavefront_bialign_step(
+    wavefront_aligner_t* const alg,
+    const int score) {
+  wavefront_compute_affine(alg,score);
+  wavefront_extend_end2end(alg,score);
+}
+wavefront_t* wavefront_bialign_get(
+    wavefront_aligner_t* const alg,
+    wavefront_t** const wavefronts,
+    const int score) {
+  const wavefront_components_t* const wf_components = &alg->wf_components;
+  const int s = (wf_components->memory_modular) ? score%wf_components->max_score_scope : score;
+  wavefront_t* const wavefront = wavefronts[s];
+  return (wavefront==NULL || wavefront->null) ? NULL : wavefront;
+}
+/*
+ * Breakpoint detection
+ *   Diagonal k_r of the reverse wavefronts is diagonal (text_length-pattern_length)-k_r
+ *   in forward coordinates, and both wavefronts overlap on it when the offsets add
+ *   up to the text length
+ */
+bool wavefront_bialign_offset_valid(
+    const int k,
+    const wf_offset_t offset,
+    const int pattern_length,
+    const int text_length) {
+  const int v = WAVEFRONT_V(k,offset);
+  return offset >= 0 && offset <= text_length && v >= 0 && v <= pattern_length;
+}
+void wavefront_bialign_overlap(
+    wavefront_t* const wf_forward,
+    wavefront_t* const wf_reverse,
+    const int pattern_length,
+    const int text_length,
+    const int score,
+    const int score_forward,
+    const int score_reverse,
+    const affine2p_matrix_type component,
+    wf_bialign_breakpoint_t* const breakpoint) {
+  if (wf_forward==NULL || wf_reverse==NULL) return;
+  if (score >= breakpoint->score) return;
+  const int k_shift = text_length-pattern_length;
+  const int lo = MAX(wf_forward->lo,k_shift-wf_reverse->hi);
+  const int hi = MIN(wf_forward->hi,k_shift-wf_reverse->lo);
+  int k;
+  for (k=lo;k<=hi;++k) {
+    const wf_offset_t offset_forward = wf_forward->offsets[k];
+    const wf_offset_t offset_reverse = wf_reverse->offsets[k_shift-k];
+    if (offset_forward + offset_reverse < text_length) continue;
+    if (!wavefront_bialign_offset_valid(k,offset_forward,pattern_length,text_length)) continue;
+    if (!wavefront_bialign_offset_valid(k_shift-k,offset_reverse,pattern_length,text_length)) continue;
+    breakpoint->score = score;
+    breakpoint->score_forward = score_forward;
+    breakpoint->score_reverse = score_reverse;
+    breakpoint->k_forward = k;
+    breakpoint->offset_forward = offset_forward;
+    breakpoint->component = component;
+    return;
+  }
+}
+void wavefront_bialign_overlap_scores(
+    wavefront_aligner_t* const alg_a,
+    const int score_a,
+    wavefront_aligner_t* const alg_b,
+    const int score_b,
+    const bool a_is_forward,
+    const int reverse_offset,
+    const int pattern_length,
+    const int text_length,
+    wf_bialign_breakpoint_t* const breakpoint) {
+  // Check the last wavefront of A against every wavefront of B in scope
+  const int gap_opening = alg_a->penalties.gap_opening1;
+  const int max_score_scope = alg_b->wf_components.max_score_scope;
+  const int score_b_min = MAX(0,score_b-max_score_scope+1);
+  wavefront_components_t* const components_a = &alg_a->wf_components;
+  wavefront_components_t* const components_b = &alg_b->wf_components;
+  wavefront_t* const mwf_a = wavefront_bialign_get(alg_a,components_a->mwavefronts,score_a);
+  wavefront_t* const iwf_a = wavefront_bialign_get(alg_a,components_a->i1wavefronts,score_a);
+  wavefront_t* const dwf_a = wavefront_bialign_get(alg_a,components_a->d1wavefronts,score_a);
+  int s;
+  for (s=score_b;s>=score_b_min;--s) {
+    wavefront_t* const mwf_b = wavefront_bialign_get(alg_b,components_b->mwavefronts,s);
+    wavefront_t* const iwf_b = wavefront_bialign_get(alg_b,components_b->i1wavefronts,s);
+    wavefront_t* const dwf_b = wavefront_bialign_get(alg_b,components_b->d1wavefronts,s);
+    const int score_forward = (a_is_forward) ? score_a : s;
+    const int score_reverse = ((a_is_forward) ? s : score_a) + reverse_offset;
+    // Both parts of a gap pay the opening
+    const int score = score_forward + score_reverse;
+    wavefront_t* const mwf_forward = (a_is_forward) ? mwf_a : mwf_b;
+    wavefront_t* const mwf_reverse = (a_is_forward) ? mwf_b : mwf_a;
+    wavefront_t* const iwf_forward = (a_is_forward) ? iwf_a : iwf_b;
+    wavefront_t* const iwf_reverse = (a_is_forward) ? iwf_b : iwf_a;
+    wavefront_t* const dwf_forward = (a_is_forward) ? dwf_a : dwf_b;
+    wavefront_t* const dwf_reverse = (a_is_forward) ? dwf_b : dwf_a;
+    wavefront_bialign_overlap(mwf_forward,mwf_reverse,pattern_length,text_length,
+        score,score_forward,score_reverse,affine2p_matrix_M,breakpoint);
+    wavefront_bialign_overlap(iwf_forward,iwf_reverse,pattern_length,text_length,
+        score-gap_opening,score_forward,score_reverse,affine2p_matrix_I1,breakpoint);
+    wavefront_bialign_overlap(dwf_forward,dwf_reverse,pattern_length,text_length,
+        score-gap_opening,score_forward,score_reverse,affine2p_matrix_D1,breakpoint);
+  }
+}
+int wavefront_bialign_find_breakpoint(
+    wavefront_bialigner_t* const wf_bialigner,
+    const char* const pattern,
+    const char* const pattern_reverse,
+    const int pattern_length,
+    const char* const text,
+    const char* const text_reverse,
+    const int text_length,
+    const affine2p_matrix_type component_begin,
+    const affine2p_matrix_type component_end,
+    const int max_alignment_score,
+    wf_bialign_breakpoint_t* const breakpoint) {
+  wavefront_aligner_t* const alg_forward = wf_bialigner->alg_forward;
+  wavefront_aligner_t* const alg_reverse = wf_bialigner->alg_reverse;
+  const int gap_opening = alg_forward->penalties.gap_opening1;
+  const int max_score_scope = alg_forward->wf_components.max_score_scope;
+  // Initialize both directions (score 0, extended). The reverse wavefronts of a
+  // subproblem ending with a gap do not count its opening, so it is added back
+  strings_padded_t* const sequences_forward = wavefront_bialign_initialize(
+      alg_forward,pattern,pattern_length,text,text_length,component_begin,false);
+  strings_padded_t* const sequences_reverse = wavefront_bialign_initialize(
+      alg_reverse,pattern_reverse,pattern_length,text_reverse,text_length,component_end,true);
+  const int reverse_offset = (component_end != affine2p_matrix_M) ? gap_opening : 0;
+  breakpoint->score = INT_MAX;
+  int score_forward = 0, score_reverse = 0;
+  wavefront_bialign_overlap_scores(
+      alg_forward,score_forward,alg_reverse,score_reverse,true,reverse_offset,
+      pattern_length,text_length,breakpoint);
+  // Grow the wavefronts, alternating directions, until no pair left to check
+  // can score less than the best breakpoint found
+  while (true) {
+    const int score_bound = score_forward + score_reverse
+        - max_score_scope + 2 - gap_opening + reverse_offset;
+    if (score_bound >= breakpoint->score || score_bound >= max_alignment_score) break;
+    if (score_forward <= score_reverse) {
+      wavefront_bialign_step(alg_forward,++score_forward);
+      wavefront_bialign_overlap_scores(
+          alg_forward,score_forward,alg_reverse,score_reverse,true,reverse_offset,
+          pattern_length,text_length,breakpoint);
+    } else {
+      wavefront_bialign_step(alg_reverse,++score_reverse);
+      wavefront_bialign_overlap_scores(
+          alg_reverse,score_reverse,alg_forward,score_forward,false,reverse_offset,
+          pattern_length,text_length,breakpoint);
+    }
+  }
+  strings_padded_delete(sequences_forward);
+  strings_padded_delete(sequences_reverse);
+  return (breakpoint->score < max_alignment_score) ? WF_ALIGN_SUCCESSFUL : WF_ALIGN_MAX_SCORE;
+}
+/*
+ * Subsidiary alignment (base cases)
+ */
+bool wavefront_bialign_terminate(
+    wavefront_aligner_t* const alg,
+    const affine2p_matrix_type component_end,
+    const int score) {
+  if (component_end == affine2p_matrix_M) {
+    return wavefront_align_end2end_terminate(alg,score);
+  }
+  // Must end with a gap
+  wavefront_components_t* const wf_components = &alg->wf_components;
+  wavefront_t* const wavefront = (component_end == affine2p_matrix_I1) ?
+      wf_components->i1wavefronts[score] : wf_components->d1wavefronts[score];
+  if (wavefront==NULL || wavefront->null) return false;
+  const int alignment_k = WAVEFRONT_DIAGONAL(alg->text_length,alg->pattern_length);
+  const wf_offset_t alignment_offset = WAVEFRONT_OFFSET(alg->text_length,alg->pattern_length);
+  if (wavefront->lo > alignment_k || alignment_k > wavefront->hi) return false;
+  if (wavefront->offsets[alignment_k] < alignment_offset) return false;
+  wavefront_backtrace_affine(alg,component_end,score,alignment_k,alignment_offset);
+  alg->cigar.score = -score;
+  return true;
+}
+void wavefront_bialign_append(
+    cigar_t* const cigar,
+    const char operation,
+    const int length) {
+  int i;
+  for (i=0;i<length;++i) {
+    cigar->operations[cigar->end_offset++] = operation;
+  }
+}
+int wavefront_bialign_subsidiary(
+    wavefront_bialigner_t* const wf_bialigner,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length,
+    const affine2p_matrix_type component_begin,
+    const affine2p_matrix_type component_end,
+    const int max_alignment_score,
+    cigar_t* const cigar) {
+  wavefront_aligner_t* const alg_subsidiary = wf_bialigner->alg_subsidiary;
+  wavefront_aligner_set_max_alignment_score(alg_subsidiary,max_alignment_score);
+  strings_padded_t* const sequences = wavefront_bialign_initialize(
+      alg_subsidiary,pattern,pattern_length,text,text_length,component_begin,false);
+  int score = 0, status = WF_ALIGN_SUCCESSFUL;
+  while (!wavefront_bialign_terminate(alg_subsidiary,component_end,score)) {
+    wavefront_bialign_step(alg_subsidiary,++score);
+    status = wavefront_align_reached_limits(alg_subsidiary,score);
+    if (status != WF_ALIGN_SUCCESSFUL) break;
+  }
+  strings_padded_delete(sequences);
+  if (status == WF_ALIGN_SUCCESSFUL) {
+    cigar_t* const sub_cigar = &alg_subsidiary->cigar;
+    const int num_operations = sub_cigar->end_offset - sub_cigar->begin_offset;
+    memcpy(cigar->operations+cigar->end_offset,
+           sub_cigar->operations+sub_cigar->begin_offset,num_operations);
+    cigar->end_offset += num_operations;
+  }
+  // Reap if maximum resident memory is reached
+  const uint64_t wf_memory_used = wavefront_aligner_get_size(alg_subsidiary);
+  if (wf_memory_used > alg_subsidiary->system.max_memory_resident) {
+    wavefront_aligner_reap(alg_subsidiary);
+  }
+  return status;
+}
+/*
+ * Recursion
+ *   Each subproblem begins in component_begin and ends in component_end, so
+ *   a gap spanning a breakpoint is opened once (by the left half)
+ */
+int wavefront_bialign_rec(
+    wavefront_bialigner_t* const wf_bialigner,
+    const char* const pattern,
+    const char* const pattern_reverse,
+    const int pattern_length,
+    const char* const text,
+    const char* const text_reverse,
+    const int text_length,
+    const affine2p_matrix_type component_begin,
+    const affine2p_matrix_type component_end,
+    const int max_alignment_score,
+    cigar_t* const cigar) {
+  // Trivial cases
+  if (pattern_length == 0) {
+    wavefront_bialign_append(cigar,'I',text_length);
+    return WF_ALIGN_SUCCESSFUL;
+  }
+  if (text_length == 0) {
+    wavefront_bialign_append(cigar,'D',pattern_length);
+    return WF_ALIGN_SUCCESSFUL;
+  }
+  // Base case: bounded score, cheap enough to align directly
+  if (max_alignment_score <= WF_BIALIGN_FALLBACK_MIN_SCORE) {
+    return wavefront_bialign_subsidiary(
+        wf_bialigner,pattern,pattern_length,text,text_length,
+        component_begin,component_end,max_alignment_score,cigar);
+  }
+  // Find the breakpoint
+  wf_bialign_breakpoint_t breakpoint;
+  const int status = wavefront_bialign_find_breakpoint(
+      wf_bialigner,pattern,pattern_reverse,pattern_length,
+      text,text_reverse,text_length,
+      component_begin,component_end,max_alignment_score,&breakpoint);
+  if (status != WF_ALIGN_SUCCESSFUL) return status;
+  const int h = WAVEFRONT_H(breakpoint.k_forward,breakpoint.offset_forward);
+  const int v = WAVEFRONT_V(breakpoint.k_forward,breakpoint.offset_forward);
+  // Base case: cheap enough to align directly (or no progress splitting)
+  if (breakpoint.score < WF_BIALIGN_FALLBACK_MIN_SCORE ||
+      (v == 0 && h == 0) || (v == pattern_length && h == text_length)) {
+    return wavefront_bialign_subsidiary(
+        wf_bialigner,pattern,pattern_length,text,text_length,
+        component_begin,component_end,breakpoint.score+1,cigar);
+  }
+  // Split and align both halves (the reverse sequences are read back to front).
+  // Each half is bounded by its part of the breakpoint score; the right half
+  // continues a gap at the breakpoint without opening it again
+  const int gap_opening = wf_bialigner->alg_forward->penalties.gap_opening1;
+  const int score_right = (breakpoint.component != affine2p_matrix_M) ?
+      breakpoint.score_reverse - gap_opening : breakpoint.score_reverse;
+  const int status_left = wavefront_bialign_rec(
+      wf_bialigner,
+      pattern,pattern_reverse+(pattern_length-v),v,
+      text,text_reverse+(text_length-h),h,
+      component_begin,breakpoint.component,
+      breakpoint.score_forward+1,cigar);
+  if (status_left != WF_ALIGN_SUCCESSFUL) return status_left;
+  return wavefront_bialign_rec(
+      wf_bialigner,
+      pattern+v,pattern_reverse,pattern_length-v,
+      text+h,text_reverse,text_length-h,
+      breakpoint.component,component_end,
+      score_right+1,cigar);
+}
+/*
+ * Bidirectional Wavefront Alignment
+ */
+int wavefront_bialign(
+    wavefront_aligner_t* const wf_aligner,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length) {
+  // Only end-to-end gap-affine is supported
+  if (wf_aligner->penalties.distance_metric != gap_affine ||
+      wf_aligner->alignment_form.span != alignment_end2end) {
+    fprintf(stderr,"[WFA] Bidirectional alignment is only implemented for end-to-end gap-affine\n");
+    exit(1);
+  }
+  if (wf_aligner->bialigner == NULL) {
+    wf_aligner->bialigner = wavefront_bialigner_new(wf_aligner);
+  }
+  // All wavefronts are kept complete (a reduced wavefront could miss the overlap)
+  wavefront_bialigner_t* const wf_bialigner = wf_aligner->bialigner;
+  // Prepare the CIGAR
+  cigar_t* const cigar = &wf_aligner->cigar;
+  cigar_resize(cigar,2*(pattern_length+text_length));
+  // Reverse the sequences
+  mm_allocator_t* const mm_allocator = wf_aligner->mm_allocator;
+  char* const pattern_reverse = mm_allocator_malloc(mm_allocator,pattern_length+1,char);
+  char* const text_reverse = mm_allocator_malloc(mm_allocator,text_length+1,char);
+  int i;
+  for (i=0;i<pattern_length;++i) pattern_reverse[i] = pattern[pattern_length-1-i];
+  for (i=0;i<text_length;++i) text_reverse[i] = text[text_length-1-i];
+  // Align
+  const int status = wavefront_bialign_rec(
+      wf_bialigner,
+      pattern,pattern_reverse,pattern_length,
+      text,text_reverse,text_length,
+      affine2p_matrix_M,affine2p_matrix_M,
+      wf_aligner->alignment_form.max_alignment_score,cigar);
+  mm_allocator_free(mm_allocator,pattern_reverse);
+  mm_allocator_free(mm_allocator,text_reverse);
+  if (status != WF_ALIGN_SUCCESSFUL) {
+    cigar->begin_offset = 0;
+    cigar->end_offset = 0;
+    cigar->score = (status == WF_ALIGN_MAX_SCORE) ? wf_aligner->alignment_form.max_alignment_score : INT32_MIN;
+    return status;
+  }
+  // Score the whole alignment
+  affine_penalties_t penalties = {
+      .match = 0,
+      .mismatch = wf_aligner->penalties.mismatch,
+      .gap_opening = wf_aligner->penalties.gap_opening1,
+      .gap_extension = wf_aligner->penalties.gap_extension1,
+  };
+  cigar->score = cigar_score_gap_affine(cigar,&penalties);
+  return WF_ALIGN_SUCCESSFUL;
+}
+
+#ifdef WFA_NAMESPACE
+}
+#endif
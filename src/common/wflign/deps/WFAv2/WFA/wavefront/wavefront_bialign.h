@@ -0,0 +1,79 @@
+/*
+ *                             The MIT License
+ *
+ * Wavefront Alignments Algorithms
+ * Copyright (c) 2017 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ * This file is part of Wavefront Alignments Algorithms.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * DESCRIPTION: Bidirectional WFA. Score-only wavefronts are computed from both
+ *   ends until they overlap; the alignment is split at the best breakpoint and
+ *   both halves are aligned recursively (a gap spanning the breakpoint is opened
+ *   by the left half and continued by the right one), so memory stays linear in
+ *   the sequence length (plus the score, for the base cases)
+ */
+
+#pragma once
+
+#include "WFA/wavefront/wavefront_aligner.h"
+
+#ifdef WFA_NAMESPACE
+namespace wfa {
+#endif
+
+/*
+ * Constants
+ */
+#define WF_BIALIGN_FALLBACK_MIN_SCORE 250 // Subproblems scoring less are aligned directly
+
+/*
+ * Bidirectional Aligner
+ */
+typedef struct _wavefront_bialigner_t {
+  wavefront_aligner_t* alg_forward;     // Score-only aligner (forward)
+  wavefront_aligner_t* alg_reverse;     // Score-only aligner (on the reversed sequences)
+  wavefront_aligner_t* alg_subsidiary;  // Full aligner for the base cases
+  mm_allocator_t* mm_allocator;         // MM-Allocator (of the owning aligner)
+} wavefront_bialigner_t;
+
+/*
+ * Setup
+ */
+wavefront_bialigner_t* wavefront_bialigner_new(
+    wavefront_aligner_t* const wf_aligner);
+void wavefront_bialigner_delete(
+    wavefront_bialigner_t* const wf_bialigner);
+
+/*
+ * Bidirectional Wavefront Alignment (end-to-end, gap-affine)
+ *   Leaves the alignment in wf_aligner->cigar
+ */
+int wavefront_bialign(
+    wavefront_aligner_t* const wf_aligner,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length);
+
+#ifdef WFA_NAMESPACE
+}
+#endif
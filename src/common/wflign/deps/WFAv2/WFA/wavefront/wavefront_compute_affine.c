@@ -31,6 +31,13 @@
 
 #include "WFA/utils/string_padded.h"
 #include "WFA/wavefront/wavefront_compute.h"
+#include "WFA/wavefront/wavefront_compute_affine.h"
+
+// The SIMD kernels pack the piggyback backtrace into 64-bit lanes
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(PCIGAR_32BITS)
+#define WAVEFRONT_COMPUTE_SIMD
+#include <immintrin.h>
+#endif
 
 #ifdef WFA_NAMESPACE
 namespace wfa {
@@ -390,6 +397,486 @@ void wavefront_compute_affine_idm_piggyback_offload(
 //  }
 //  wf_backtrace_buffer_add_used(bt_buffer,current_pos-global_pos);
 //}
+#ifdef WAVEFRONT_COMPUTE_SIMD
+/*
+ * Compute Kernels (AVX2/AVX512)
+ *   Each kernel covers the whole [lo,hi] range in a single loop. Diagonals
+ *   outside the limits of an input wavefront are masked off the loads and
+ *   read as WAVEFRONT_OFFSET_NULL (as WF_COND_FETCH does); the last vector
+ *   is stored under a mask. Backtraces follow the bounded kernels (ties
+ *   prefer M-sub, then D, then I; gap extension over gap open; negative
+ *   offsets reset the piggyback)
+ */
+__attribute__((target("avx2")))
+static inline __m256i wavefront_compute_avx2_limits(
+    const int k,
+    const int lo,
+    const int hi) {
+  const __m256i diagonals = _mm256_add_epi32(
+      _mm256_set1_epi32(k),_mm256_setr_epi32(0,1,2,3,4,5,6,7));
+  const __m256i outside = _mm256_or_si256(
+      _mm256_cmpgt_epi32(_mm256_set1_epi32(lo),diagonals),
+      _mm256_cmpgt_epi32(diagonals,_mm256_set1_epi32(hi)));
+  return _mm256_xor_si256(outside,_mm256_set1_epi32(-1));
+}
+__attribute__((target("avx2")))
+static inline __m256i wavefront_compute_avx2_fetch(
+    const wf_offset_t* const offsets,
+    const int lo,
+    const int hi,
+    const int k,
+    const int inc,
+    __m256i* const mask) {
+  const __m256i increment = _mm256_set1_epi32(inc);
+  if (lo <= k && k+7 <= hi) {
+    *mask = _mm256_set1_epi32(-1);
+    return _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(offsets+k)),increment);
+  }
+  *mask = wavefront_compute_avx2_limits(k,lo,hi);
+  const __m256i offset = _mm256_add_epi32(_mm256_maskload_epi32(offsets+k,*mask),increment);
+  return _mm256_blendv_epi8(_mm256_set1_epi32(WAVEFRONT_OFFSET_NULL),offset,*mask);
+}
+__attribute__((target("avx2")))
+static inline __m256i wavefront_compute_avx2_mask_lo(const __m256i mask) {
+  return _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask));
+}
+__attribute__((target("avx2")))
+static inline __m256i wavefront_compute_avx2_mask_hi(const __m256i mask) {
+  return _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask,1));
+}
+__attribute__((target("avx2")))
+static inline __m256i wavefront_compute_avx2_pcigar(
+    const pcigar_t* const pcigar_a,
+    const __m256i mask_a,
+    const pcigar_t* const pcigar_b,
+    const __m256i mask_b,
+    const __m256i select_b,
+    const __m256i valid,
+    const pcigar_t operation) {
+  const __m256i pcigar = _mm256_blendv_epi8(
+      _mm256_maskload_epi64((const long long*)pcigar_a,mask_a),
+      _mm256_maskload_epi64((const long long*)pcigar_b,mask_b),select_b);
+  return _mm256_and_si256(valid,_mm256_or_si256(
+      _mm256_slli_epi64(pcigar,2),_mm256_set1_epi64x(operation)));
+}
+__attribute__((target("avx2")))
+void wavefront_compute_affine_idm_avx2(
+    const wavefront_set_t* const wavefront_set,
+    const int lo,
+    const int hi) {
+  // In Offsets
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_mwavefront_sub,m_sub);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_mwavefront_gap1,m_open1);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_i1wavefront_ext,i1_ext);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_d1wavefront_ext,d1_ext);
+  // Out Offsets
+  wf_offset_t* const out_m = wavefront_set->out_mwavefront->offsets;
+  wf_offset_t* const out_i1 = wavefront_set->out_i1wavefront->offsets;
+  wf_offset_t* const out_d1 = wavefront_set->out_d1wavefront->offsets;
+  // Compute-Next kernel loop
+  const __m256i one = _mm256_set1_epi32(1);
+  __m256i mask;
+  int k;
+  for (k=lo;k<=hi;k+=8) {
+    // Update I1
+    const __m256i ins1_o = wavefront_compute_avx2_fetch(m_open1,m_open1_lo,m_open1_hi,k-1,0,&mask);
+    const __m256i ins1_e = wavefront_compute_avx2_fetch(i1_ext,i1_ext_lo,i1_ext_hi,k-1,0,&mask);
+    const __m256i ins1 = _mm256_add_epi32(_mm256_max_epi32(ins1_o,ins1_e),one);
+    // Update D1
+    const __m256i del1_o = wavefront_compute_avx2_fetch(m_open1,m_open1_lo,m_open1_hi,k+1,0,&mask);
+    const __m256i del1_e = wavefront_compute_avx2_fetch(d1_ext,d1_ext_lo,d1_ext_hi,k+1,0,&mask);
+    const __m256i del1 = _mm256_max_epi32(del1_o,del1_e);
+    // Update M
+    const __m256i sub = wavefront_compute_avx2_fetch(m_sub,m_sub_lo,m_sub_hi,k,1,&mask);
+    const __m256i max = _mm256_max_epi32(del1,_mm256_max_epi32(sub,ins1));
+    // Store
+    if (k+7 <= hi) {
+      _mm256_storeu_si256((__m256i*)(out_i1+k),ins1);
+      _mm256_storeu_si256((__m256i*)(out_d1+k),del1);
+      _mm256_storeu_si256((__m256i*)(out_m+k),max);
+    } else {
+      const __m256i out_mask = wavefront_compute_avx2_limits(k,lo,hi);
+      _mm256_maskstore_epi32(out_i1+k,out_mask,ins1);
+      _mm256_maskstore_epi32(out_d1+k,out_mask,del1);
+      _mm256_maskstore_epi32(out_m+k,out_mask,max);
+    }
+  }
+}
+__attribute__((target("avx2")))
+void wavefront_compute_affine_idm_piggyback_avx2(
+    const wavefront_set_t* const wavefront_set,
+    const int lo,
+    const int hi) {
+  // In Offsets
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_mwavefront_sub,m_sub);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_mwavefront_gap1,m_open1);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_i1wavefront_ext,i1_ext);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_d1wavefront_ext,d1_ext);
+  // Out Offsets
+  wf_offset_t* const out_m = wavefront_set->out_mwavefront->offsets;
+  wf_offset_t* const out_i1 = wavefront_set->out_i1wavefront->offsets;
+  wf_offset_t* const out_d1 = wavefront_set->out_d1wavefront->offsets;
+  // In BT-pcigar
+  const pcigar_t* const m_sub_bt_pcigar   = wavefront_set->in_mwavefront_sub->bt_pcigar;
+  const pcigar_t* const m_open1_bt_pcigar = wavefront_set->in_mwavefront_gap1->bt_pcigar;
+  const pcigar_t* const i1_ext_bt_pcigar  = wavefront_set->in_i1wavefront_ext->bt_pcigar;
+  const pcigar_t* const d1_ext_bt_pcigar  = wavefront_set->in_d1wavefront_ext->bt_pcigar;
+  // In BT-prev
+  const block_idx_t* const m_sub_bt_prev   = wavefront_set->in_mwavefront_sub->bt_prev;
+  const block_idx_t* const m_open1_bt_prev = wavefront_set->in_mwavefront_gap1->bt_prev;
+  const block_idx_t* const i1_ext_bt_prev  = wavefront_set->in_i1wavefront_ext->bt_prev;
+  const block_idx_t* const d1_ext_bt_prev  = wavefront_set->in_d1wavefront_ext->bt_prev;
+  // Out BT-pcigar
+  pcigar_t* const out_m_bt_pcigar   = wavefront_set->out_mwavefront->bt_pcigar;
+  pcigar_t* const out_i1_bt_pcigar  = wavefront_set->out_i1wavefront->bt_pcigar;
+  pcigar_t* const out_d1_bt_pcigar  = wavefront_set->out_d1wavefront->bt_pcigar;
+  // Out BT-prev
+  block_idx_t* const out_m_bt_prev  = wavefront_set->out_mwavefront->bt_prev;
+  block_idx_t* const out_i1_bt_prev = wavefront_set->out_i1wavefront->bt_prev;
+  block_idx_t* const out_d1_bt_prev = wavefront_set->out_d1wavefront->bt_prev;
+  // Compute-Next kernel loop
+  const __m256i negative = _mm256_set1_epi32(-1);
+  int k;
+  for (k=lo;k<=hi;k+=8) {
+    /*
+     * Insertion Block
+     */
+    __m256i ins1_o_mask, ins1_e_mask;
+    const __m256i ins1_o = wavefront_compute_avx2_fetch(m_open1,m_open1_lo,m_open1_hi,k-1,1,&ins1_o_mask);
+    const __m256i ins1_e = wavefront_compute_avx2_fetch(i1_ext,i1_ext_lo,i1_ext_hi,k-1,1,&ins1_e_mask);
+    const __m256i ins1 = _mm256_max_epi32(ins1_o,ins1_e);
+    const __m256i ins1_from_e = _mm256_cmpeq_epi32(ins1,ins1_e);
+    const __m256i ins1_valid = _mm256_cmpgt_epi32(ins1,negative);
+    const __m256i ins1_prev = _mm256_and_si256(ins1_valid,_mm256_blendv_epi8(
+        _mm256_maskload_epi32((const int*)(m_open1_bt_prev+k-1),ins1_o_mask),
+        _mm256_maskload_epi32((const int*)(i1_ext_bt_prev+k-1),ins1_e_mask),ins1_from_e));
+    const __m256i ins1_pcigar_lo = wavefront_compute_avx2_pcigar(
+        m_open1_bt_pcigar+k-1,wavefront_compute_avx2_mask_lo(ins1_o_mask),
+        i1_ext_bt_pcigar+k-1,wavefront_compute_avx2_mask_lo(ins1_e_mask),
+        wavefront_compute_avx2_mask_lo(ins1_from_e),
+        wavefront_compute_avx2_mask_lo(ins1_valid),PCIGAR_INSERTION);
+    const __m256i ins1_pcigar_hi = wavefront_compute_avx2_pcigar(
+        m_open1_bt_pcigar+k+3,wavefront_compute_avx2_mask_hi(ins1_o_mask),
+        i1_ext_bt_pcigar+k+3,wavefront_compute_avx2_mask_hi(ins1_e_mask),
+        wavefront_compute_avx2_mask_hi(ins1_from_e),
+        wavefront_compute_avx2_mask_hi(ins1_valid),PCIGAR_INSERTION);
+    /*
+     * Deletion Block
+     */
+    __m256i del1_o_mask, del1_e_mask;
+    const __m256i del1_o = wavefront_compute_avx2_fetch(m_open1,m_open1_lo,m_open1_hi,k+1,0,&del1_o_mask);
+    const __m256i del1_e = wavefront_compute_avx2_fetch(d1_ext,d1_ext_lo,d1_ext_hi,k+1,0,&del1_e_mask);
+    const __m256i del1 = _mm256_max_epi32(del1_o,del1_e);
+    const __m256i del1_from_e = _mm256_cmpeq_epi32(del1,del1_e);
+    const __m256i del1_valid = _mm256_cmpgt_epi32(del1,negative);
+    const __m256i del1_prev = _mm256_and_si256(del1_valid,_mm256_blendv_epi8(
+        _mm256_maskload_epi32((const int*)(m_open1_bt_prev+k+1),del1_o_mask),
+        _mm256_maskload_epi32((const int*)(d1_ext_bt_prev+k+1),del1_e_mask),del1_from_e));
+    const __m256i del1_pcigar_lo = wavefront_compute_avx2_pcigar(
+        m_open1_bt_pcigar+k+1,wavefront_compute_avx2_mask_lo(del1_o_mask),
+        d1_ext_bt_pcigar+k+1,wavefront_compute_avx2_mask_lo(del1_e_mask),
+        wavefront_compute_avx2_mask_lo(del1_from_e),
+        wavefront_compute_avx2_mask_lo(del1_valid),PCIGAR_DELETION);
+    const __m256i del1_pcigar_hi = wavefront_compute_avx2_pcigar(
+        m_open1_bt_pcigar+k+5,wavefront_compute_avx2_mask_hi(del1_o_mask),
+        d1_ext_bt_pcigar+k+5,wavefront_compute_avx2_mask_hi(del1_e_mask),
+        wavefront_compute_avx2_mask_hi(del1_from_e),
+        wavefront_compute_avx2_mask_hi(del1_valid),PCIGAR_DELETION);
+    /*
+     * Mismatch Block
+     */
+    __m256i sub_mask;
+    const __m256i sub = wavefront_compute_avx2_fetch(m_sub,m_sub_lo,m_sub_hi,k,1,&sub_mask);
+    const __m256i max = _mm256_max_epi32(del1,_mm256_max_epi32(sub,ins1));
+    const __m256i max_from_sub = _mm256_cmpeq_epi32(max,sub);
+    const __m256i max_from_del1 = _mm256_cmpeq_epi32(max,del1);
+    const __m256i max_valid = _mm256_cmpgt_epi32(max,negative);
+    const __m256i max_prev = _mm256_and_si256(max_valid,_mm256_blendv_epi8(
+        _mm256_blendv_epi8(ins1_prev,del1_prev,max_from_del1),
+        _mm256_maskload_epi32((const int*)(m_sub_bt_prev+k),sub_mask),max_from_sub));
+    // Coming from I/D -> X is fake to represent gap-close
+    // Coming from M -> X is real to represent mismatch
+    const __m256i indel1_pcigar_lo = _mm256_blendv_epi8(
+        ins1_pcigar_lo,del1_pcigar_lo,wavefront_compute_avx2_mask_lo(max_from_del1));
+    const __m256i indel1_pcigar_hi = _mm256_blendv_epi8(
+        ins1_pcigar_hi,del1_pcigar_hi,wavefront_compute_avx2_mask_hi(max_from_del1));
+    const __m256i max_pcigar_lo = _mm256_and_si256(wavefront_compute_avx2_mask_lo(max_valid),
+        _mm256_or_si256(_mm256_slli_epi64(_mm256_blendv_epi8(indel1_pcigar_lo,
+            _mm256_maskload_epi64((const long long*)(m_sub_bt_pcigar+k),wavefront_compute_avx2_mask_lo(sub_mask)),
+            wavefront_compute_avx2_mask_lo(max_from_sub)),2),_mm256_set1_epi64x(PCIGAR_MISMATCH)));
+    const __m256i max_pcigar_hi = _mm256_and_si256(wavefront_compute_avx2_mask_hi(max_valid),
+        _mm256_or_si256(_mm256_slli_epi64(_mm256_blendv_epi8(indel1_pcigar_hi,
+            _mm256_maskload_epi64((const long long*)(m_sub_bt_pcigar+k+4),wavefront_compute_avx2_mask_hi(sub_mask)),
+            wavefront_compute_avx2_mask_hi(max_from_sub)),2),_mm256_set1_epi64x(PCIGAR_MISMATCH)));
+    /*
+     * Store
+     */
+    if (k+7 <= hi) {
+      _mm256_storeu_si256((__m256i*)(out_i1+k),ins1);
+      _mm256_storeu_si256((__m256i*)(out_i1_bt_prev+k),ins1_prev);
+      _mm256_storeu_si256((__m256i*)(out_i1_bt_pcigar+k),ins1_pcigar_lo);
+      _mm256_storeu_si256((__m256i*)(out_i1_bt_pcigar+k+4),ins1_pcigar_hi);
+      _mm256_storeu_si256((__m256i*)(out_d1+k),del1);
+      _mm256_storeu_si256((__m256i*)(out_d1_bt_prev+k),del1_prev);
+      _mm256_storeu_si256((__m256i*)(out_d1_bt_pcigar+k),del1_pcigar_lo);
+      _mm256_storeu_si256((__m256i*)(out_d1_bt_pcigar+k+4),del1_pcigar_hi);
+      _mm256_storeu_si256((__m256i*)(out_m+k),max);
+      _mm256_storeu_si256((__m256i*)(out_m_bt_prev+k),max_prev);
+      _mm256_storeu_si256((__m256i*)(out_m_bt_pcigar+k),max_pcigar_lo);
+      _mm256_storeu_si256((__m256i*)(out_m_bt_pcigar+k+4),max_pcigar_hi);
+    } else {
+      const __m256i out_mask = wavefront_compute_avx2_limits(k,lo,hi);
+      const __m256i out_mask_lo = wavefront_compute_avx2_mask_lo(out_mask);
+      const __m256i out_mask_hi = wavefront_compute_avx2_mask_hi(out_mask);
+      _mm256_maskstore_epi32(out_i1+k,out_mask,ins1);
+      _mm256_maskstore_epi32((int*)(out_i1_bt_prev+k),out_mask,ins1_prev);
+      _mm256_maskstore_epi64((long long*)(out_i1_bt_pcigar+k),out_mask_lo,ins1_pcigar_lo);
+      _mm256_maskstore_epi64((long long*)(out_i1_bt_pcigar+k+4),out_mask_hi,ins1_pcigar_hi);
+      _mm256_maskstore_epi32(out_d1+k,out_mask,del1);
+      _mm256_maskstore_epi32((int*)(out_d1_bt_prev+k),out_mask,del1_prev);
+      _mm256_maskstore_epi64((long long*)(out_d1_bt_pcigar+k),out_mask_lo,del1_pcigar_lo);
+      _mm256_maskstore_epi64((long long*)(out_d1_bt_pcigar+k+4),out_mask_hi,del1_pcigar_hi);
+      _mm256_maskstore_epi32(out_m+k,out_mask,max);
+      _mm256_maskstore_epi32((int*)(out_m_bt_prev+k),out_mask,max_prev);
+      _mm256_maskstore_epi64((long long*)(out_m_bt_pcigar+k),out_mask_lo,max_pcigar_lo);
+      _mm256_maskstore_epi64((long long*)(out_m_bt_pcigar+k+4),out_mask_hi,max_pcigar_hi);
+    }
+  }
+}
+__attribute__((target("avx512f")))
+static inline __mmask16 wavefront_compute_avx512_limits(
+    const int k,
+    const int lo,
+    const int hi) {
+  const __m512i diagonals = _mm512_add_epi32(_mm512_set1_epi32(k),
+      _mm512_setr_epi32(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15));
+  return _mm512_cmpge_epi32_mask(diagonals,_mm512_set1_epi32(lo)) &
+         _mm512_cmple_epi32_mask(diagonals,_mm512_set1_epi32(hi));
+}
+__attribute__((target("avx512f")))
+static inline __m512i wavefront_compute_avx512_fetch(
+    const wf_offset_t* const offsets,
+    const int lo,
+    const int hi,
+    const int k,
+    const int inc,
+    __mmask16* const mask) {
+  *mask = wavefront_compute_avx512_limits(k,lo,hi);
+  return _mm512_mask_add_epi32(_mm512_set1_epi32(WAVEFRONT_OFFSET_NULL),*mask,
+      _mm512_maskz_loadu_epi32(*mask,offsets+k),_mm512_set1_epi32(inc));
+}
+__attribute__((target("avx512f")))
+static inline __m512i wavefront_compute_avx512_pcigar(
+    const pcigar_t* const pcigar_a,
+    const __mmask8 mask_a,
+    const pcigar_t* const pcigar_b,
+    const __mmask8 mask_b,
+    const __mmask8 select_b,
+    const __mmask8 valid,
+    const pcigar_t operation) {
+  const __m512i pcigar = _mm512_mask_blend_epi64(select_b,
+      _mm512_maskz_loadu_epi64(mask_a,pcigar_a),
+      _mm512_maskz_loadu_epi64(mask_b,pcigar_b));
+  return _mm512_maskz_or_epi64(valid,
+      _mm512_slli_epi64(pcigar,2),_mm512_set1_epi64(operation));
+}
+__attribute__((target("avx512f")))
+void wavefront_compute_affine_idm_avx512(
+    const wavefront_set_t* const wavefront_set,
+    const int lo,
+    const int hi) {
+  // In Offsets
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_mwavefront_sub,m_sub);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_mwavefront_gap1,m_open1);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_i1wavefront_ext,i1_ext);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_d1wavefront_ext,d1_ext);
+  // Out Offsets
+  wf_offset_t* const out_m = wavefront_set->out_mwavefront->offsets;
+  wf_offset_t* const out_i1 = wavefront_set->out_i1wavefront->offsets;
+  wf_offset_t* const out_d1 = wavefront_set->out_d1wavefront->offsets;
+  // Compute-Next kernel loop
+  const __m512i one = _mm512_set1_epi32(1);
+  __mmask16 mask;
+  int k;
+  for (k=lo;k<=hi;k+=16) {
+    // Update I1
+    const __m512i ins1_o = wavefront_compute_avx512_fetch(m_open1,m_open1_lo,m_open1_hi,k-1,0,&mask);
+    const __m512i ins1_e = wavefront_compute_avx512_fetch(i1_ext,i1_ext_lo,i1_ext_hi,k-1,0,&mask);
+    const __m512i ins1 = _mm512_add_epi32(_mm512_max_epi32(ins1_o,ins1_e),one);
+    // Update D1
+    const __m512i del1_o = wavefront_compute_avx512_fetch(m_open1,m_open1_lo,m_open1_hi,k+1,0,&mask);
+    const __m512i del1_e = wavefront_compute_avx512_fetch(d1_ext,d1_ext_lo,d1_ext_hi,k+1,0,&mask);
+    const __m512i del1 = _mm512_max_epi32(del1_o,del1_e);
+    // Update M
+    const __m512i sub = wavefront_compute_avx512_fetch(m_sub,m_sub_lo,m_sub_hi,k,1,&mask);
+    const __m512i max = _mm512_max_epi32(del1,_mm512_max_epi32(sub,ins1));
+    // Store
+    const __mmask16 out_mask = wavefront_compute_avx512_limits(k,lo,hi);
+    _mm512_mask_storeu_epi32(out_i1+k,out_mask,ins1);
+    _mm512_mask_storeu_epi32(out_d1+k,out_mask,del1);
+    _mm512_mask_storeu_epi32(out_m+k,out_mask,max);
+  }
+}
+__attribute__((target("avx512f")))
+void wavefront_compute_affine_idm_piggyback_avx512(
+    const wavefront_set_t* const wavefront_set,
+    const int lo,
+    const int hi) {
+  // In Offsets
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_mwavefront_sub,m_sub);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_mwavefront_gap1,m_open1);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_i1wavefront_ext,i1_ext);
+  WF_DECLARE_OFFSETS__LIMITS(wavefront_set->in_d1wavefront_ext,d1_ext);
+  // Out Offsets
+  wf_offset_t* const out_m = wavefront_set->out_mwavefront->offsets;
+  wf_offset_t* const out_i1 = wavefront_set->out_i1wavefront->offsets;
+  wf_offset_t* const out_d1 = wavefront_set->out_d1wavefront->offsets;
+  // In BT-pcigar
+  const pcigar_t* const m_sub_bt_pcigar   = wavefront_set->in_mwavefront_sub->bt_pcigar;
+  const pcigar_t* const m_open1_bt_pcigar = wavefront_set->in_mwavefront_gap1->bt_pcigar;
+  const pcigar_t* const i1_ext_bt_pcigar  = wavefront_set->in_i1wavefront_ext->bt_pcigar;
+  const pcigar_t* const d1_ext_bt_pcigar  = wavefront_set->in_d1wavefront_ext->bt_pcigar;
+  // In BT-prev
+  const block_idx_t* const m_sub_bt_prev   = wavefront_set->in_mwavefront_sub->bt_prev;
+  const block_idx_t* const m_open1_bt_prev = wavefront_set->in_mwavefront_gap1->bt_prev;
+  const block_idx_t* const i1_ext_bt_prev  = wavefront_set->in_i1wavefront_ext->bt_prev;
+  const block_idx_t* const d1_ext_bt_prev  = wavefront_set->in_d1wavefront_ext->bt_prev;
+  // Out BT-pcigar
+  pcigar_t* const out_m_bt_pcigar   = wavefront_set->out_mwavefront->bt_pcigar;
+  pcigar_t* const out_i1_bt_pcigar  = wavefront_set->out_i1wavefront->bt_pcigar;
+  pcigar_t* const out_d1_bt_pcigar  = wavefront_set->out_d1wavefront->bt_pcigar;
+  // Out BT-prev
+  block_idx_t* const out_m_bt_prev  = wavefront_set->out_mwavefront->bt_prev;
+  block_idx_t* const out_i1_bt_prev = wavefront_set->out_i1wavefront->bt_prev;
+  block_idx_t* const out_d1_bt_prev = wavefront_set->out_d1wavefront->bt_prev;
+  // Compute-Next kernel loop
+  const __m512i negative = _mm512_set1_epi32(-1);
+  int k;
+  for (k=lo;k<=hi;k+=16) {
+    /*
+     * Insertion Block
+     */
+    __mmask16 ins1_o_mask, ins1_e_mask;
+    const __m512i ins1_o = wavefront_compute_avx512_fetch(m_open1,m_open1_lo,m_open1_hi,k-1,1,&ins1_o_mask);
+    const __m512i ins1_e = wavefront_compute_avx512_fetch(i1_ext,i1_ext_lo,i1_ext_hi,k-1,1,&ins1_e_mask);
+    const __m512i ins1 = _mm512_max_epi32(ins1_o,ins1_e);
+    const __mmask16 ins1_from_e = _mm512_cmpeq_epi32_mask(ins1,ins1_e);
+    const __mmask16 ins1_valid = _mm512_cmpgt_epi32_mask(ins1,negative);
+    const __m512i ins1_prev = _mm512_maskz_mov_epi32(ins1_valid,_mm512_mask_blend_epi32(ins1_from_e,
+        _mm512_maskz_loadu_epi32(ins1_o_mask,m_open1_bt_prev+k-1),
+        _mm512_maskz_loadu_epi32(ins1_e_mask,i1_ext_bt_prev+k-1)));
+    const __m512i ins1_pcigar_lo = wavefront_compute_avx512_pcigar(
+        m_open1_bt_pcigar+k-1,(__mmask8)ins1_o_mask,i1_ext_bt_pcigar+k-1,(__mmask8)ins1_e_mask,
+        (__mmask8)ins1_from_e,(__mmask8)ins1_valid,PCIGAR_INSERTION);
+    const __m512i ins1_pcigar_hi = wavefront_compute_avx512_pcigar(
+        m_open1_bt_pcigar+k+7,(__mmask8)(ins1_o_mask>>8),i1_ext_bt_pcigar+k+7,(__mmask8)(ins1_e_mask>>8),
+        (__mmask8)(ins1_from_e>>8),(__mmask8)(ins1_valid>>8),PCIGAR_INSERTION);
+    /*
+     * Deletion Block
+     */
+    __mmask16 del1_o_mask, del1_e_mask;
+    const __m512i del1_o = wavefront_compute_avx512_fetch(m_open1,m_open1_lo,m_open1_hi,k+1,0,&del1_o_mask);
+    const __m512i del1_e = wavefront_compute_avx512_fetch(d1_ext,d1_ext_lo,d1_ext_hi,k+1,0,&del1_e_mask);
+    const __m512i del1 = _mm512_max_epi32(del1_o,del1_e);
+    const __mmask16 del1_from_e = _mm512_cmpeq_epi32_mask(del1,del1_e);
+    const __mmask16 del1_valid = _mm512_cmpgt_epi32_mask(del1,negative);
+    const __m512i del1_prev = _mm512_maskz_mov_epi32(del1_valid,_mm512_mask_blend_epi32(del1_from_e,
+        _mm512_maskz_loadu_epi32(del1_o_mask,m_open1_bt_prev+k+1),
+        _mm512_maskz_loadu_epi32(del1_e_mask,d1_ext_bt_prev+k+1)));
+    const __m512i del1_pcigar_lo = wavefront_compute_avx512_pcigar(
+        m_open1_bt_pcigar+k+1,(__mmask8)del1_o_mask,d1_ext_bt_pcigar+k+1,(__mmask8)del1_e_mask,
+        (__mmask8)del1_from_e,(__mmask8)del1_valid,PCIGAR_DELETION);
+    const __m512i del1_pcigar_hi = wavefront_compute_avx512_pcigar(
+        m_open1_bt_pcigar+k+9,(__mmask8)(del1_o_mask>>8),d1_ext_bt_pcigar+k+9,(__mmask8)(del1_e_mask>>8),
+        (__mmask8)(del1_from_e>>8),(__mmask8)(del1_valid>>8),PCIGAR_DELETION);
+    /*
+     * Mismatch Block
+     */
+    __mmask16 sub_mask;
+    const __m512i sub = wavefront_compute_avx512_fetch(m_sub,m_sub_lo,m_sub_hi,k,1,&sub_mask);
+    const __m512i max = _mm512_max_epi32(del1,_mm512_max_epi32(sub,ins1));
+    const __mmask16 max_from_sub = _mm512_cmpeq_epi32_mask(max,sub);
+    const __mmask16 max_from_del1 = _mm512_cmpeq_epi32_mask(max,del1);
+    const __mmask16 max_valid = _mm512_cmpgt_epi32_mask(max,negative);
+    const __m512i max_prev = _mm512_maskz_mov_epi32(max_valid,_mm512_mask_blend_epi32(max_from_sub,
+        _mm512_mask_blend_epi32(max_from_del1,ins1_prev,del1_prev),
+        _mm512_maskz_loadu_epi32(sub_mask,m_sub_bt_prev+k)));
+    // Coming from I/D -> X is fake to represent gap-close
+    // Coming from M -> X is real to represent mismatch
+    const __m512i max_pcigar_lo = _mm512_maskz_or_epi64((__mmask8)max_valid,
+        _mm512_slli_epi64(_mm512_mask_blend_epi64((__mmask8)max_from_sub,
+            _mm512_mask_blend_epi64((__mmask8)max_from_del1,ins1_pcigar_lo,del1_pcigar_lo),
+            _mm512_maskz_loadu_epi64((__mmask8)sub_mask,m_sub_bt_pcigar+k)),2),
+        _mm512_set1_epi64(PCIGAR_MISMATCH));
+    const __m512i max_pcigar_hi = _mm512_maskz_or_epi64((__mmask8)(max_valid>>8),
+        _mm512_slli_epi64(_mm512_mask_blend_epi64((__mmask8)(max_from_sub>>8),
+            _mm512_mask_blend_epi64((__mmask8)(max_from_del1>>8),ins1_pcigar_hi,del1_pcigar_hi),
+            _mm512_maskz_loadu_epi64((__mmask8)(sub_mask>>8),m_sub_bt_pcigar+k+8)),2),
+        _mm512_set1_epi64(PCIGAR_MISMATCH));
+    /*
+     * Store
+     */
+    const __mmask16 out_mask = wavefront_compute_avx512_limits(k,lo,hi);
+    const __mmask8 out_mask_lo = (__mmask8)out_mask;
+    const __mmask8 out_mask_hi = (__mmask8)(out_mask>>8);
+    _mm512_mask_storeu_epi32(out_i1+k,out_mask,ins1);
+    _mm512_mask_storeu_epi32(out_i1_bt_prev+k,out_mask,ins1_prev);
+    _mm512_mask_storeu_epi64(out_i1_bt_pcigar+k,out_mask_lo,ins1_pcigar_lo);
+    _mm512_mask_storeu_epi64(out_i1_bt_pcigar+k+8,out_mask_hi,ins1_pcigar_hi);
+    _mm512_mask_storeu_epi32(out_d1+k,out_mask,del1);
+    _mm512_mask_storeu_epi32(out_d1_bt_prev+k,out_mask,del1_prev);
+    _mm512_mask_storeu_epi64(out_d1_bt_pcigar+k,out_mask_lo,del1_pcigar_lo);
+    _mm512_mask_storeu_epi64(out_d1_bt_pcigar+k+8,out_mask_hi,del1_pcigar_hi);
+    _mm512_mask_storeu_epi32(out_m+k,out_mask,max);
+    _mm512_mask_storeu_epi32(out_m_bt_prev+k,out_mask,max_prev);
+    _mm512_mask_storeu_epi64(out_m_bt_pcigar+k,out_mask_lo,max_pcigar_lo);
+    _mm512_mask_storeu_epi64(out_m_bt_pcigar+k+8,out_mask_hi,max_pcigar_hi);
+  }
+}
+#endif
+/*
+ * Kernel selection
+ */
+static wf_compute_kernel_t wavefront_compute_affine_kernel = wf_compute_kernel_auto;
+static wf_compute_kernel_t wavefront_compute_affine_kernel_selected = wf_compute_kernel_auto;
+wf_compute_kernel_t wavefront_compute_affine_kernel_select(
+    wf_compute_kernel_t kernel) {
+#ifdef WAVEFRONT_COMPUTE_SIMD
+  const bool avx512 = __builtin_cpu_supports("avx512f");
+  const bool avx2 = __builtin_cpu_supports("avx2");
+#else
+  const bool avx512 = false, avx2 = false;
+#endif
+  if (kernel == wf_compute_kernel_auto) {
+    kernel = avx2 ? wf_compute_kernel_avx2 : wf_compute_kernel_scalar;
+  }
+  if (kernel == wf_compute_kernel_avx512 && avx512) return wf_compute_kernel_avx512;
+  if (kernel >= wf_compute_kernel_avx2 && avx2) return wf_compute_kernel_avx2;
+  return wf_compute_kernel_scalar;
+}
+void wavefront_compute_affine_set_kernel(
+    const wf_compute_kernel_t kernel) {
+  __atomic_store_n(&wavefront_compute_affine_kernel,kernel,__ATOMIC_RELAXED);
+  __atomic_store_n(&wavefront_compute_affine_kernel_selected,
+      wavefront_compute_affine_kernel_select(kernel),__ATOMIC_RELAXED);
+}
+const char* wavefront_compute_affine_get_kernel_name() {
+  switch (wavefront_compute_affine_kernel_select(
+      __atomic_load_n(&wavefront_compute_affine_kernel,__ATOMIC_RELAXED))) {
+    case wf_compute_kernel_avx512: return "avx512";
+    case wf_compute_kernel_avx2: return "avx2";
+    default: return "scalar";
+  }
+}
+wf_compute_kernel_t wavefront_compute_affine_get_kernel() {
+  wf_compute_kernel_t kernel =
+      __atomic_load_n(&wavefront_compute_affine_kernel_selected,__ATOMIC_RELAXED);
+  if (__builtin_expect(kernel==wf_compute_kernel_auto,0)) {
+    kernel = wavefront_compute_affine_kernel_select(wf_compute_kernel_auto);
+    __atomic_store_n(&wavefront_compute_affine_kernel_selected,kernel,__ATOMIC_RELAXED);
+  }
+  return kernel;
+}
 /*
  * Compute Wavefront (IDM)
  */
@@ -397,30 +884,56 @@ void wavefront_compute_affine_idm(
     const wavefront_set_t* const wavefront_set,
     const int lo,
     const int hi) {
-  // Compute loop peeling limits [max_lo,min_hi] (dense region where all the offsets exists
-  int min_hi, max_lo;
-  wavefront_compute_limits_dense(wavefront_set,gap_affine,&max_lo,&min_hi);
-  // Compute wavefronts (prologue)
-  wavefront_compute_affine_idm_bounded(wavefront_set,lo,max_lo-1);
-  // Compute wavefronts (core)
-  wavefront_compute_affine_idm_unbounded(wavefront_set,max_lo,min_hi);
-  // Compute wavefronts (epilogue)
-  wavefront_compute_affine_idm_bounded(wavefront_set,min_hi+1,hi);
+  switch (wavefront_compute_affine_get_kernel()) {
+#ifdef WAVEFRONT_COMPUTE_SIMD
+    case wf_compute_kernel_avx512:
+      wavefront_compute_affine_idm_avx512(wavefront_set,lo,hi);
+      break;
+    case wf_compute_kernel_avx2:
+      wavefront_compute_affine_idm_avx2(wavefront_set,lo,hi);
+      break;
+#endif
+    default: {
+      // Compute loop peeling limits [max_lo,min_hi] (dense region where all the offsets exists
+      int min_hi, max_lo;
+      wavefront_compute_limits_dense(wavefront_set,gap_affine,&max_lo,&min_hi);
+      // Compute wavefronts (prologue)
+      wavefront_compute_affine_idm_bounded(wavefront_set,lo,max_lo-1);
+      // Compute wavefronts (core)
+      wavefront_compute_affine_idm_unbounded(wavefront_set,max_lo,min_hi);
+      // Compute wavefronts (epilogue)
+      wavefront_compute_affine_idm_bounded(wavefront_set,min_hi+1,hi);
+      break;
+    }
+  }
 }
 void wavefront_compute_affine_idm_piggyback(
     const wavefront_set_t* const wavefront_set,
     const int lo,
     const int hi,
     wf_backtrace_buffer_t* const bt_buffer) {
-  // Compute loop peeling limits [max_lo,min_hi] (dense region where all the offsets exists)
-  int min_hi, max_lo;
-  wavefront_compute_limits_dense(wavefront_set,gap_affine,&max_lo,&min_hi);
-  // Compute wavefronts (prologue)
-  wavefront_compute_affine_idm_piggyback_bounded(wavefront_set,lo,max_lo-1);
-  // Compute wavefronts (core)
-  wavefront_compute_affine_idm_piggyback_unbounded(wavefront_set,max_lo,min_hi);
-  // Compute wavefronts (epilogue)
-  wavefront_compute_affine_idm_piggyback_bounded(wavefront_set,min_hi+1,hi);
+  switch (wavefront_compute_affine_get_kernel()) {
+#ifdef WAVEFRONT_COMPUTE_SIMD
+    case wf_compute_kernel_avx512:
+      wavefront_compute_affine_idm_piggyback_avx512(wavefront_set,lo,hi);
+      break;
+    case wf_compute_kernel_avx2:
+      wavefront_compute_affine_idm_piggyback_avx2(wavefront_set,lo,hi);
+      break;
+#endif
+    default: {
+      // Compute loop peeling limits [max_lo,min_hi] (dense region where all the offsets exists)
+      int min_hi, max_lo;
+      wavefront_compute_limits_dense(wavefront_set,gap_affine,&max_lo,&min_hi);
+      // Compute wavefronts (prologue)
+      wavefront_compute_affine_idm_piggyback_bounded(wavefront_set,lo,max_lo-1);
+      // Compute wavefronts (core)
+      wavefront_compute_affine_idm_piggyback_unbounded(wavefront_set,max_lo,min_hi);
+      // Compute wavefronts (epilogue)
+      wavefront_compute_affine_idm_piggyback_bounded(wavefront_set,min_hi+1,hi);
+      break;
+    }
+  }
   // Offload backtrace
   wavefront_compute_affine_idm_piggyback_offload(wavefront_set,lo,hi,bt_buffer);
 }
@@ -34,27 +34,26 @@
 #include "WFA/wavefront/wavefront_compute.h"
 #include "WFA/wavefront/wavefront_reduction.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
 #ifdef WFA_NAMESPACE
 namespace wfa {
 #endif
 
 /*
- * Wavefront offset extension comparing characters
+ * Wavefront offset extension comparing characters (portable)
  *   // TODO Avoid register spilling in x86
  */
-bool wavefront_extend_packed(
-    wavefront_aligner_t* const wf_aligner,
-    const int score,
-    const bool endsfree) {
-  // Fetch m-wavefront
-  wavefront_t* const mwavefront = wf_aligner->wf_components.mwavefronts[score];
-  if (mwavefront==NULL) return false;
-  // Extend diagonally each wavefront point
-  const int pattern_length = wf_aligner->pattern_length;
-  const int text_length = wf_aligner->text_length;
-  wf_offset_t* const offsets = mwavefront->offsets;
-  const int lo = mwavefront->lo;
-  const int hi = mwavefront->hi;
+void wavefront_extend_packed_kernel_scalar(
+    wf_offset_t* const offsets,
+    const int lo,
+    const int hi,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length) {
   int k;
   for (k=lo;k<=hi;++k) {
     // Fetch offset & positions
@@ -72,8 +71,8 @@ bool wavefront_extend_packed(
       continue;
     }
     // Fetch pattern/text blocks
-    uint64_t* pattern_blocks = (uint64_t*)(wf_aligner->pattern+v);
-    uint64_t* text_blocks = (uint64_t*)(wf_aligner->text+h);
+    uint64_t* pattern_blocks = (uint64_t*)(pattern+v);
+    uint64_t* text_blocks = (uint64_t*)(text+h);
     // Compare 64-bits blocks
     uint64_t cmp = *pattern_blocks ^ *text_blocks;
     while (__builtin_expect(cmp==0,0)) {
@@ -91,8 +90,165 @@ bool wavefront_extend_packed(
     offset += equal_chars;
     // Update offset
     offsets[k] = offset;
-    // Check ends-free reaching boundaries
-    if (endsfree) {
+  }
+}
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+/*
+ * Wavefront offset extension comparing characters (AVX2)
+ *   Most diagonals stop within a few characters, so the first 8 are compared
+ *   as in the portable kernel; only the diagonals matching all of them
+ *   continue 32 characters per step
+ */
+__attribute__((target("avx2")))
+static inline int wavefront_extend_matches_avx2(
+    const char* const pattern,
+    const char* const text) {
+  const uint64_t cmp = *(const uint64_t*)pattern ^ *(const uint64_t*)text;
+  if (cmp != 0) return DIV_FLOOR(__builtin_ctzl(cmp),8);
+  int equal_chars = 8;
+  while (true) {
+    const __m256i pattern_block = _mm256_loadu_si256((const __m256i*)(pattern+equal_chars));
+    const __m256i text_block = _mm256_loadu_si256((const __m256i*)(text+equal_chars));
+    const uint32_t equal_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(pattern_block,text_block));
+    if (equal_mask != UINT32_MAX) return equal_chars + __builtin_ctz(~equal_mask);
+    equal_chars += 32;
+  }
+}
+__attribute__((target("avx2")))
+void wavefront_extend_packed_kernel_avx2(
+    wf_offset_t* const offsets,
+    const int lo,
+    const int hi,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length) {
+  int k;
+  for (k=lo;k<=hi;++k) {
+    const wf_offset_t offset = offsets[k];
+    const uint32_t h = WAVEFRONT_H(k,offset); // Make unsigned to avoid checking negative
+    const uint32_t v = WAVEFRONT_V(k,offset); // Make unsigned to avoid checking negative
+    if (h > text_length || v > pattern_length) {
+      offsets[k] = WAVEFRONT_OFFSET_NULL;
+      continue;
+    }
+    offsets[k] = offset + wavefront_extend_matches_avx2(pattern+v,text+h);
+  }
+}
+/*
+ * Wavefront offset extension comparing characters (AVX-512)
+ *   Same as AVX2, 64 characters per step
+ */
+__attribute__((target("avx512f,avx512bw")))
+static inline int wavefront_extend_matches_avx512(
+    const char* const pattern,
+    const char* const text) {
+  const uint64_t cmp = *(const uint64_t*)pattern ^ *(const uint64_t*)text;
+  if (cmp != 0) return DIV_FLOOR(__builtin_ctzl(cmp),8);
+  int equal_chars = 8;
+  while (true) {
+    const __m512i pattern_block = _mm512_loadu_si512((const void*)(pattern+equal_chars));
+    const __m512i text_block = _mm512_loadu_si512((const void*)(text+equal_chars));
+    const uint64_t diff_mask = _mm512_cmpneq_epi8_mask(pattern_block,text_block);
+    if (diff_mask != 0) return equal_chars + __builtin_ctzll(diff_mask);
+    equal_chars += 64;
+  }
+}
+__attribute__((target("avx512f,avx512bw")))
+void wavefront_extend_packed_kernel_avx512(
+    wf_offset_t* const offsets,
+    const int lo,
+    const int hi,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length) {
+  int k;
+  for (k=lo;k<=hi;++k) {
+    const wf_offset_t offset = offsets[k];
+    const uint32_t h = WAVEFRONT_H(k,offset); // Make unsigned to avoid checking negative
+    const uint32_t v = WAVEFRONT_V(k,offset); // Make unsigned to avoid checking negative
+    if (h > text_length || v > pattern_length) {
+      offsets[k] = WAVEFRONT_OFFSET_NULL;
+      continue;
+    }
+    offsets[k] = offset + wavefront_extend_matches_avx512(pattern+v,text+h);
+  }
+}
+#endif
+/*
+ * Kernel selection
+ */
+typedef void (*wavefront_extend_kernel_f)(
+    wf_offset_t* const offsets,
+    const int lo,
+    const int hi,
+    const char* const pattern,
+    const int pattern_length,
+    const char* const text,
+    const int text_length);
+static wf_extend_kernel_t wavefront_extend_kernel = wf_extend_kernel_auto;
+static wavefront_extend_kernel_f wavefront_extend_kernel_function = NULL;
+
+wavefront_extend_kernel_f wavefront_extend_kernel_select(
+    wf_extend_kernel_t kernel) {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  const bool avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+  const bool avx2 = __builtin_cpu_supports("avx2");
+  // AVX-512 measured no faster than AVX2 (the first 8 characters settle most
+  // diagonals), so it is only used when asked for
+  if (kernel == wf_extend_kernel_auto) {
+    kernel = avx2 ? wf_extend_kernel_avx2 : wf_extend_kernel_scalar;
+  }
+  if (kernel == wf_extend_kernel_avx512 && avx512) return &wavefront_extend_packed_kernel_avx512;
+  if (kernel >= wf_extend_kernel_avx2 && avx2) return &wavefront_extend_packed_kernel_avx2;
+#endif
+  return &wavefront_extend_packed_kernel_scalar;
+}
+void wavefront_extend_set_kernel(
+    const wf_extend_kernel_t kernel) {
+  __atomic_store_n(&wavefront_extend_kernel,kernel,__ATOMIC_RELAXED);
+  __atomic_store_n(&wavefront_extend_kernel_function,
+      wavefront_extend_kernel_select(kernel),__ATOMIC_RELAXED);
+}
+const char* wavefront_extend_get_kernel_name() {
+  wavefront_extend_kernel_f function =
+      wavefront_extend_kernel_select(__atomic_load_n(&wavefront_extend_kernel,__ATOMIC_RELAXED));
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  if (function == &wavefront_extend_packed_kernel_avx512) return "avx512";
+  if (function == &wavefront_extend_packed_kernel_avx2) return "avx2";
+#endif
+  return "scalar";
+}
+/*
+ * Wavefront offset extension
+ */
+bool wavefront_extend_packed(
+    wavefront_aligner_t* const wf_aligner,
+    const int score,
+    const bool endsfree) {
+  // Fetch m-wavefront
+  wavefront_t* const mwavefront = wf_aligner->wf_components.mwavefronts[score];
+  if (mwavefront==NULL) return false;
+  // Extend diagonally each wavefront point
+  const int pattern_length = wf_aligner->pattern_length;
+  const int text_length = wf_aligner->text_length;
+  wf_offset_t* const offsets = mwavefront->offsets;
+  const int lo = mwavefront->lo;
+  const int hi = mwavefront->hi;
+  wavefront_extend_kernel_f kernel =
+      __atomic_load_n(&wavefront_extend_kernel_function,__ATOMIC_RELAXED);
+  if (__builtin_expect(kernel==NULL,0)) {
+    kernel = wavefront_extend_kernel_select(wf_extend_kernel_auto);
+    __atomic_store_n(&wavefront_extend_kernel_function,kernel,__ATOMIC_RELAXED);
+  }
+  kernel(offsets,lo,hi,wf_aligner->pattern,pattern_length,wf_aligner->text,text_length);
+  // Check ends-free reaching boundaries
+  if (endsfree) {
+    int k;
+    for (k=lo;k<=hi;++k) {
+      const wf_offset_t offset = offsets[k];
+      if (offset == WAVEFRONT_OFFSET_NULL) continue;
       const int h_pos = WAVEFRONT_H(k,offset);
       const int v_pos = WAVEFRONT_V(k,offset);
       if (h_pos >= text_length) { // Text is aligned
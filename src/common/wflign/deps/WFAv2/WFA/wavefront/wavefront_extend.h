@@ -40,7 +40,24 @@ namespace wfa {
 /*
  * Constants
  */
-#define WAVEFRONT_PADDING  10
+#define WAVEFRONT_PADDING  64 // Covers a full AVX-512 block past the sentinels
+
+/*
+ * Extend kernels (selected at runtime from the CPU features)
+ */
+typedef enum {
+  wf_extend_kernel_auto,    // Fastest kernel the CPU supports
+  wf_extend_kernel_scalar,  // Portable (8 characters per step)
+  wf_extend_kernel_avx2,    // 32 characters per step (past the first 8)
+  wf_extend_kernel_avx512,  // 64 characters per step (past the first 8)
+} wf_extend_kernel_t;
+
+/*
+ * Kernel selection (process-wide; unsupported kernels fall back to a narrower one)
+ */
+void wavefront_extend_set_kernel(
+    const wf_extend_kernel_t kernel);
+const char* wavefront_extend_get_kernel_name();
 
 /*
  * Wavefront exact "extension"
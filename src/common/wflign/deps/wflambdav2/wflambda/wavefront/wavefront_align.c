@@ -41,55 +41,6 @@
 namespace wflambda {
 #endif
 
-/*
- * Alignment end reached
- */
-bool wavefront_align_global_terminate(
-    wavefront_aligner_t* const wf_aligner,
-    const std::function<bool(const int&, const int&)>& traceback_lambda,
-    const int pattern_length,
-    const int text_length,
-    const int score_final) {
-  // Parameters
-  const int alignment_k = WAVEFRONT_DIAGONAL(text_length,pattern_length);
-  const int alignment_offset = WAVEFRONT_OFFSET(text_length,pattern_length);
-  int score = score_final;
-  // Check wavefront
-  if (wf_aligner->memory_modular) score = score % wf_aligner->max_score_scope;
-  wavefront_t* const mwavefront = wf_aligner->mwavefronts[score];
-  if (mwavefront==NULL) return false;
-  // Check limits
-  wf_offset_t* const offsets = mwavefront->offsets;
-  if (mwavefront->lo > alignment_k || alignment_k > mwavefront->hi) return false;
-  // Check offset
-  const wf_offset_t offset = offsets[alignment_k];
-  if (offset < alignment_offset) return false; // Global termination condition
-  // Retrieve alignment
-  if (wf_aligner->alignment_scope == alignment_scope_score) {
-    wf_aligner->cigar.begin_offset = 0;
-    wf_aligner->cigar.end_offset = 0;
-    wf_aligner->cigar.score = -score_final;
-  } else {
-    if (wf_aligner->bt_piggyback) {
-      // Fetch backtrace from buffer and recover alignment
-      //ToDo
-      wf_backtrace_buffer_recover_cigar(
-          wf_aligner->bt_buffer,
-          mwavefront->bt_pcigar[alignment_k],
-          mwavefront->bt_prev[alignment_k],
-          traceback_lambda,
-          pattern_length,text_length,&wf_aligner->cigar);
-    } else {
-      // Backtrace alignment
-      wavefront_backtrace_affine(wf_aligner,
-                                 traceback_lambda,
-                                 pattern_length,text_length,
-                                 score);
-    }
-  }
-  // Terminate
-  return true;
-}
 /*
  * Initial Conditions
  */
@@ -111,101 +62,6 @@ void wavefront_align_global_initialize(
   wf_aligner->d2wavefronts[0] = NULL;
   wf_aligner->i2wavefronts[0] = NULL;
 }
-/*
- * Global Alignment
- */
-int wavefront_align_global(
-    wavefront_aligner_t* const wf_aligner,
-    const std::function<bool(const int&, const int&)>& match_lambda,
-    const std::function<bool(const int&, const int&)>& traceback_lambda,
-    const int pattern_length,
-    const int text_length) {
-  // Parameters
-  const distance_metric_t distance_metric = wf_aligner->distance_metric;
-  // Initialize wavefront
-  wavefront_align_global_initialize(wf_aligner);
-  // Compute wavefronts of increasing score
-  int score = 0;
-  while (true) {
-    // Exact extend s-wavefront
-    wavefront_extend(wf_aligner, match_lambda,
-                     pattern_length, text_length,
-                     score);
-    // Exit condition
-    if (wavefront_align_global_terminate(
-        wf_aligner,traceback_lambda,pattern_length,text_length,score)) break;
-    // Compute (s+1)-wavefront
-    ++score;
-    switch (distance_metric) {
-      case gap_affine:
-        wavefront_compute_affine(wf_aligner,
-                                 pattern_length, text_length,
-                                 score);
-        break;
-      case gap_affine_2p:
-        wavefront_compute_affine2p(wf_aligner,
-                                   pattern_length,text_length,
-                                   score);
-        break;
-      default:
-        fprintf(stderr,"Distance function not yet implemented\n"); exit(1);
-        break;
-    }
-    // DEBUG
-    //wavefront_aligner_print(stderr,wf_aligner,score,score,2,16);
-  }
-  return score;
-}
-/*
- * Bounded Global Alignment
- */
-int wavefront_align_global_bounded(
-    wavefront_aligner_t* const wf_aligner,
-    const std::function<bool(const int&, const int&)>& match_lambda,
-    const std::function<bool(const int&, const int&)>& traceback_lambda,
-    const int pattern_length,
-    const int text_length,
-    const int max_score) {
-  // Parameters
-  const distance_metric_t distance_metric = wf_aligner->distance_metric;
-  // Initialize wavefront
-  wavefront_align_global_initialize(wf_aligner);
-  // Compute wavefronts of increasing score
-  int score = 0;
-  while (true) {
-    // Exact extend s-wavefront
-    wavefront_extend(wf_aligner,match_lambda,
-                     pattern_length,text_length,
-                     score);
-    // Exit condition
-    if (wavefront_align_global_terminate(
-        wf_aligner,traceback_lambda,pattern_length,text_length,score)) break;
-    // Compute (s+1)-wavefront
-    ++score;
-    // Bound the alignment at our max_score
-    if (score > max_score) {
-        break; // todo... signal failure somehow
-    }
-    switch (distance_metric) {
-      case gap_affine:
-        wavefront_compute_affine(wf_aligner,
-                                 pattern_length,text_length,
-                                 score);
-        break;
-      case gap_affine_2p:
-        wavefront_compute_affine2p(wf_aligner,
-                                   pattern_length,text_length,
-                                   score);
-        break;
-      default:
-        fprintf(stderr,"Distance function not yet implemented\n"); exit(1);
-        break;
-    }
-    // DEBUG
-    //wavefront_aligner_print(stderr,wf_aligner,score,score,2,16);
-  }
-  return score;
-}
 /*
  * Semi-Global Alignment
  */
@@ -217,38 +73,25 @@ void wavefront_align_semiglobal(
   // TODO Incorporate HERE the end-condition
 }
 /*
- * Wavefront Alignment
+ * Type-erased instantiations (for callers passing std::function)
  */
-int wavefront_align(
+template int wavefront_align<
+    std::function<bool(const int&, const int&)>,
+    std::function<bool(const int&, const int&)>>(
     wavefront_aligner_t* const wf_aligner,
     const std::function<bool(const int&, const int&)>& match_lambda,
     const std::function<bool(const int&, const int&)>& traceback_lambda,
     const int pattern_length,
-    const int text_length) {
-
-  // Alignment computing wavefronts
-  int score = wavefront_align_global(wf_aligner,match_lambda,traceback_lambda,pattern_length,text_length);
-
-  // Return our resulting score
-  return score;
-}
-/*
- * Bounded Wavefront Alignment
- */
-int wavefront_align_bounded(
+    const int text_length);
+template int wavefront_align_bounded<
+    std::function<bool(const int&, const int&)>,
+    std::function<bool(const int&, const int&)>>(
     wavefront_aligner_t* const wf_aligner,
     const std::function<bool(const int&, const int&)>& match_lambda,
     const std::function<bool(const int&, const int&)>& traceback_lambda,
     const int pattern_length,
     const int text_length,
-    const int max_score) {
-
-  // Alignment computing wavefronts
-  int score = wavefront_align_global_bounded(wf_aligner,match_lambda,traceback_lambda,pattern_length,text_length,max_score);
-
-  // Return our resulting score
-  return score;
-}
+    const int max_score);
 
 #ifdef WFLAMBDA_NAMESPACE
 }
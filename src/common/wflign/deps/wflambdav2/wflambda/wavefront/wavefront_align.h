@@ -33,31 +33,210 @@
 
 #include <functional>
 #include "wflambda/wavefront/wavefront_aligner.h"
+#include "wflambda/wavefront/wavefront_extend.h"
+#include "wflambda/wavefront/wavefront_compute_affine.h"
+#include "wflambda/wavefront/wavefront_compute_affine2p.h"
+#include "wflambda/wavefront/wavefront_backtrace.h"
 #include "wflambda/wavefront/wavefront_display.h" // For convenience
 
 #ifdef WFLAMBDA_NAMESPACE
 namespace wflambda {
 #endif
 
+/*
+ * The alignment loop is templated on the match/traceback functions, so that
+ * they can be inlined into the extend loop. Passing std::function (as
+ * instantiated in wavefront_align.c) type-erases them instead
+ */
+
+/*
+ * Initial Conditions
+ */
+void wavefront_align_global_initialize(
+    wavefront_aligner_t* const wf_aligner);
+
+/*
+ * Alignment end reached
+ */
+template <typename TracebackFunction>
+bool wavefront_align_global_terminate(
+    wavefront_aligner_t* const wf_aligner,
+    const TracebackFunction& traceback_lambda,
+    const int pattern_length,
+    const int text_length,
+    const int score_final) {
+  // Parameters
+  const int alignment_k = WAVEFRONT_DIAGONAL(text_length,pattern_length);
+  const int alignment_offset = WAVEFRONT_OFFSET(text_length,pattern_length);
+  int score = score_final;
+  // Check wavefront
+  if (wf_aligner->memory_modular) score = score % wf_aligner->max_score_scope;
+  wavefront_t* const mwavefront = wf_aligner->mwavefronts[score];
+  if (mwavefront==NULL) return false;
+  // Check limits
+  wf_offset_t* const offsets = mwavefront->offsets;
+  if (mwavefront->lo > alignment_k || alignment_k > mwavefront->hi) return false;
+  // Check offset
+  const wf_offset_t offset = offsets[alignment_k];
+  if (offset < alignment_offset) return false; // Global termination condition
+  // Retrieve alignment
+  if (wf_aligner->alignment_scope == alignment_scope_score) {
+    wf_aligner->cigar.begin_offset = 0;
+    wf_aligner->cigar.end_offset = 0;
+    wf_aligner->cigar.score = -score_final;
+  } else {
+    if (wf_aligner->bt_piggyback) {
+      // Fetch backtrace from buffer and recover alignment
+      //ToDo
+      wf_backtrace_buffer_recover_cigar(
+          wf_aligner->bt_buffer,
+          mwavefront->bt_pcigar[alignment_k],
+          mwavefront->bt_prev[alignment_k],
+          traceback_lambda,
+          pattern_length,text_length,&wf_aligner->cigar);
+    } else {
+      // Backtrace alignment
+      wavefront_backtrace_affine(wf_aligner,
+                                 traceback_lambda,
+                                 pattern_length,text_length,
+                                 score);
+    }
+  }
+  // Terminate
+  return true;
+}
+/*
+ * Global Alignment
+ */
+template <typename MatchFunction, typename TracebackFunction>
+int wavefront_align_global(
+    wavefront_aligner_t* const wf_aligner,
+    const MatchFunction& match_lambda,
+    const TracebackFunction& traceback_lambda,
+    const int pattern_length,
+    const int text_length) {
+  // Parameters
+  const distance_metric_t distance_metric = wf_aligner->distance_metric;
+  // Initialize wavefront
+  wavefront_align_global_initialize(wf_aligner);
+  // Compute wavefronts of increasing score
+  int score = 0;
+  while (true) {
+    // Exact extend s-wavefront
+    wavefront_extend(wf_aligner, match_lambda,
+                     pattern_length, text_length,
+                     score);
+    // Exit condition
+    if (wavefront_align_global_terminate(
+        wf_aligner,traceback_lambda,pattern_length,text_length,score)) break;
+    // Compute (s+1)-wavefront
+    ++score;
+    switch (distance_metric) {
+      case gap_affine:
+        wavefront_compute_affine(wf_aligner,
+                                 pattern_length, text_length,
+                                 score);
+        break;
+      case gap_affine_2p:
+        wavefront_compute_affine2p(wf_aligner,
+                                   pattern_length,text_length,
+                                   score);
+        break;
+      default:
+        fprintf(stderr,"Distance function not yet implemented\n"); exit(1);
+        break;
+    }
+    // DEBUG
+    //wavefront_aligner_print(stderr,wf_aligner,score,score,2,16);
+  }
+  return score;
+}
+/*
+ * Bounded Global Alignment
+ */
+template <typename MatchFunction, typename TracebackFunction>
+int wavefront_align_global_bounded(
+    wavefront_aligner_t* const wf_aligner,
+    const MatchFunction& match_lambda,
+    const TracebackFunction& traceback_lambda,
+    const int pattern_length,
+    const int text_length,
+    const int max_score) {
+  // Parameters
+  const distance_metric_t distance_metric = wf_aligner->distance_metric;
+  // Initialize wavefront
+  wavefront_align_global_initialize(wf_aligner);
+  // Compute wavefronts of increasing score
+  int score = 0;
+  while (true) {
+    // Exact extend s-wavefront
+    wavefront_extend(wf_aligner,match_lambda,
+                     pattern_length,text_length,
+                     score);
+    // Exit condition
+    if (wavefront_align_global_terminate(
+        wf_aligner,traceback_lambda,pattern_length,text_length,score)) break;
+    // Compute (s+1)-wavefront
+    ++score;
+    // Bound the alignment at our max_score
+    if (score > max_score) {
+        break; // todo... signal failure somehow
+    }
+    switch (distance_metric) {
+      case gap_affine:
+        wavefront_compute_affine(wf_aligner,
+                                 pattern_length,text_length,
+                                 score);
+        break;
+      case gap_affine_2p:
+        wavefront_compute_affine2p(wf_aligner,
+                                   pattern_length,text_length,
+                                   score);
+        break;
+      default:
+        fprintf(stderr,"Distance function not yet implemented\n"); exit(1);
+        break;
+    }
+    // DEBUG
+    //wavefront_aligner_print(stderr,wf_aligner,score,score,2,16);
+  }
+  return score;
+}
 /*
  * Wavefront Alignment
  */
+template <typename MatchFunction, typename TracebackFunction>
 int wavefront_align(
     wavefront_aligner_t* const wf_aligner,
-    const std::function<bool(const int&, const int&)>& match_lambda,
-    const std::function<bool(const int&, const int&)>& traceback_lambda,
+    const MatchFunction& match_lambda,
+    const TracebackFunction& traceback_lambda,
     const int pattern_length,
-    const int text_length);
+    const int text_length) {
+
+  // Alignment computing wavefronts
+  int score = wavefront_align_global(wf_aligner,match_lambda,traceback_lambda,pattern_length,text_length);
+
+  // Return our resulting score
+  return score;
+}
 /*
  * Bounded Wavefront Alignment
  */
+template <typename MatchFunction, typename TracebackFunction>
 int wavefront_align_bounded(
     wavefront_aligner_t* const wf_aligner,
-    const std::function<bool(const int&, const int&)>& match_lambda,
-    const std::function<bool(const int&, const int&)>& traceback_lambda,
+    const MatchFunction& match_lambda,
+    const TracebackFunction& traceback_lambda,
     const int pattern_length,
     const int text_length,
-    const int max_score);
+    const int max_score) {
+
+  // Alignment computing wavefronts
+  int score = wavefront_align_global_bounded(wf_aligner,match_lambda,traceback_lambda,pattern_length,text_length,max_score);
+
+  // Return our resulting score
+  return score;
+}
 
 #ifdef WFLAMBDA_NAMESPACE
 }
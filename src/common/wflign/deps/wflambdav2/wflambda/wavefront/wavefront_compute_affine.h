@@ -37,6 +37,23 @@
 namespace wflambda {
 #endif
 
+/*
+ * Compute kernels (selected at runtime from the CPU features)
+ */
+typedef enum {
+  wf_compute_kernel_auto,    // Fastest kernel the CPU supports
+  wf_compute_kernel_scalar,  // Portable (peeled bounded/unbounded loops)
+  wf_compute_kernel_avx2,    // 8 diagonals per step
+  wf_compute_kernel_avx512,  // 16 diagonals per step
+} wf_compute_kernel_t;
+
+/*
+ * Kernel selection (process-wide; unsupported kernels fall back to a narrower one)
+ */
+void wavefront_compute_affine_set_kernel(
+    const wf_compute_kernel_t kernel);
+const char* wavefront_compute_affine_get_kernel_name();
+
 /*
  * Compute wavefront (gap-affine)
  */
@@ -31,7 +31,9 @@
 
 #pragma once
 
+#include <functional>
 #include "wflambda/wavefront/wavefront_aligner.h"
+#include "wflambda/wavefront/wavefront_reduction.h"
 
 #ifdef WFLAMBDA_NAMESPACE
 namespace wflambda {
@@ -42,15 +44,55 @@ namespace wflambda {
  */
 #define WAVEFRONT_PADDING  10
 
+/*
+ * Wavefront offset extension comparing characters
+ *   Templated on the match function, so that it can be inlined into the
+ *   extend loop (std::function is instantiated in wavefront_extend.c)
+ */
+template <typename MatchFunction>
+void wavefront_extend_packed(
+    wavefront_aligner_t* const wf_aligner,
+    const MatchFunction& match_lambda,
+    const int pattern_length,
+    const int text_length,
+    const int score) {
+  // Fetch m-wavefront
+  wavefront_t* const mwavefront = wf_aligner->mwavefronts[score];
+  if (mwavefront==NULL) return;
+  // Extend diagonally each wavefront point
+  wf_offset_t* const offsets = mwavefront->offsets;
+  int k;
+  for (k=mwavefront->lo;k<=mwavefront->hi;++k) {
+    // Fetch offset & positions
+    wf_offset_t offset = offsets[k];
+    uint32_t h = WAVEFRONT_H(k,offset); // Make unsigned to avoid checking negative
+    uint32_t v = WAVEFRONT_V(k,offset); // Make unsigned to avoid checking negative
+
+    while (h < text_length&& v < pattern_length && match_lambda(v++,h++)) {
+        ++(offsets[k]);
+    }
+  }
+}
 /*
  * Wavefront exact "extension"
  */
+template <typename MatchFunction>
 void wavefront_extend(
     wavefront_aligner_t* const wf_aligner,
-    const std::function<bool(const int&, const int&)>& match_lambda,
+    const MatchFunction& match_lambda,
     const int pattern_length,
     const int text_length,
-    int score);
+    int score) {
+  // Modular wavefront
+  if (wf_aligner->memory_modular) score = score % wf_aligner->max_score_scope;
+  // Extend wavefront
+  wavefront_extend_packed(
+      wf_aligner,match_lambda,pattern_length,text_length,score);
+  // Reduce wavefront dynamically
+  if (wf_aligner->reduction.reduction_strategy == wavefront_reduction_dynamic) {
+    wavefront_reduce(wf_aligner,pattern_length,text_length,score);
+  }
+}
 
 #ifdef WFLAMBDA_NAMESPACE
 }
@@ -2,120 +2,123 @@
 
 namespace rkmh {
 
-// Check a string (as a char*) for non-canonical DNA bases
-inline bool canonical(const char *x, int len) {
-    bool trip = false;
-    for (int i = 0; i < len; ++i) {
-        trip |= valid_dna[x[i]];
-    }
-    return !trip;
+// 2-bit encoding of the nucleotides, 4 for everything else
+static const uint8_t nt_2bit[256] = {
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
 };
 
-/* Reverse complement the string seq
- * (assumes seq is DNA, and returns non-ACTG letters as-is*/
-
-/* Reverse complement a C string
- * NB: does not check safety of string lengths.
- * NB: ret is modified to hold the reverse complement of seq.
- * */
-
-inline void reverse_complement(const char *seq, char *ret, int len) {
-
-    //assert(seq != ret);
-    if (ret == nullptr) {
-        ret = new char[len + 1];
-    }
+// MurmurHash3's 64-bit finalizer, a bijection that scrambles the packed k-mer
+inline uint64_t mix_kmer(uint64_t x) {
+    x ^= 42;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
 
-    for (int i = len - 1; i >= 0; i--) {
-        ret[len - 1 - i] = (char) rev_arr[(int) seq[i] - 65];
+// whether seq has a kmer of length k made of A, C, G and T only
+bool has_valid_kmer(const char* seq, const uint64_t& len, const uint64_t& k) {
+    uint64_t valid = 0;
+    for (uint64_t p = 0; p < len; ++p) {
+        valid = nt_2bit[(uint8_t)seq[p]] > 3 ? 0 : valid + 1;
+        if (valid >= k) {
+            return true;
+        }
     }
-    ret[len] = '\0';
-};
+    return false;
+}
 
-/** Primary calc_hashes function **/
-/** Takes the string to be hashed, its length,
- *  a single kmer size, a pointer to hold the hashes,
- *  and an integer to hold the number of hashes.
- *
- *  Possibly thread safe:
- *      seq, len and k are not modified
- *      new [] operator is known threadsafe
- *      User must handle hashes and numhashes properly in calling function.
- **/
-inline void calc_hashes_(const char *seq, const uint64_t &len,
-                         const uint64_t &k, hash_t *&hashes, int numhashes) {
-    char reverse[k + 1];
-    char rhash[16];
-    char fhash[16];
-    for (int i = 0; i < numhashes; ++i) {
-        if (canonical(seq + i, k)) {
-            reverse_complement(seq + i, reverse, k);
-            MurmurHash3_x64_128(seq + i, k, 42, &fhash);
-            MurmurHash3_x64_128(reverse, k, 42, &rhash);
-            hash_t tmp_fwd = *((hash_t*)fhash);
-            hash_t tmp_rev = *((hash_t*)rhash);
-            hashes[i] = (tmp_fwd < tmp_rev ? tmp_fwd : tmp_rev);
-            //std::cerr << "hashes[" << i << "] = " << hashes[i] << std::endl;
-        } else {
-            hashes[i] = std::numeric_limits<hash_t>::max();
+/* Calculate the hashes of all the kmers of length k (k <= 32) of seq, one per
+ * start position. The forward and reverse complement 2-bit encodings are
+ * rolled along the sequence and the smaller of the two is hashed, so both
+ * strands of a k-mer get the same hash. Kmers containing anything else than
+ * A, C, G and T get the max hash, which sketch_kmers skips.
+ */
+std::vector<hash_t> hash_kmers(const char* seq,
+                               const uint64_t& len,
+                               const uint64_t& k) {
+    assert(k > 0 && k <= 32);
+    std::vector<hash_t> hashes(len >= k ? len - k + 1 : 0,
+                               std::numeric_limits<hash_t>::max());
+    const uint64_t shift = 2 * (k - 1);
+    const uint64_t mask = k == 32 ? ~(uint64_t)0 : ((uint64_t)1 << (2 * k)) - 1;
+    uint64_t fwd = 0;
+    uint64_t rev = 0;
+    uint64_t valid = 0; // length of the current run of valid bases
+    for (uint64_t p = 0; p < len; ++p) {
+        const uint64_t c = nt_2bit[(uint8_t)seq[p]];
+        if (c > 3) {
+            valid = 0;
+            continue;
+        }
+        fwd = ((fwd << 2) | c) & mask;
+        rev = (rev >> 2) | ((3 - c) << shift);
+        if (++valid >= k) {
+            // hash_t is 32-bit, as the truncated MurmurHash3_x64_128 hashes were
+            const hash_t hash = mix_kmer(fwd < rev ? fwd : rev) >> 32;
+            // keep the max for the invalid kmers
+            hashes[p + 1 - k] = hash == std::numeric_limits<hash_t>::max() ? hash - 1 : hash;
         }
     }
-};
-
-/* Calculate all the hashes of the kmers length k of seq */
-inline std::vector<hash_t> calc_hashes(const char *seq,
-                                       const uint64_t& seq_length,
-                                       const uint64_t& k) {
-    int numhashes = seq_length - k;
-    std::vector<hash_t> ret(numhashes);
-    hash_t *hashes = ret.data();
-    calc_hashes_(seq, seq_length, k, hashes, numhashes);
-    return ret;
-};
+    return hashes;
+}
 
-/*
-inline std::vector<hash_t> calc_hashes(const char *seq, const uint64_t &len, const uint64_t& k) {
-    std::vector<hash_t> ret;
-    std::vector<hash_t> t = calc_hashes(seq, len, k);
-    ret.insert(ret.end(), t.begin(), t.end());
-    return ret;
-};
-*/
-
-std::vector<hash_t> hash_sequence(const char* seq,
-                                  const uint64_t& len,
-                                  const uint64_t& k,
-                                  const uint64_t& sketch_size) {
-    std::vector<hash_t> hashes = calc_hashes(seq, len, k);
-    std::sort(hashes.begin(), hashes.end());
-    if (hashes.size() > sketch_size) {
-        hashes.erase(hashes.begin()+sketch_size, hashes.end());
+uint64_t sketch_kmers(const hash_t* kmer_hashes,
+                      const uint64_t& num_kmers,
+                      const uint64_t& sketch_size,
+                      std::vector<hash_t>& buffer,
+                      hash_t* sketch) {
+    buffer.clear();
+    for (uint64_t p = 0; p < num_kmers; ++p) {
+        if (kmer_hashes[p] != std::numeric_limits<hash_t>::max()) {
+            buffer.push_back(kmer_hashes[p]);
+        }
     }
-    // we remove non-canonical hashes which sort last
-    if (hashes.back() == std::numeric_limits<hash_t>::max()) {
-        hashes.erase(std::find(hashes.begin(), hashes.end(),
-                               std::numeric_limits<hash_t>::max()),
-                     hashes.end());
+    // keep the bottom sketch_size hashes, sorted
+    if (buffer.size() > sketch_size) {
+        std::nth_element(buffer.begin(), buffer.begin() + sketch_size, buffer.end());
+        buffer.resize(sketch_size);
     }
-    return hashes;
+    std::sort(buffer.begin(), buffer.end());
+    std::copy(buffer.begin(), buffer.end(), sketch);
+    return buffer.size();
 }
 
-float compare(const std::vector<hash_t>& alpha, const std::vector<hash_t>& beta, const uint64_t& k) {
+float compare(const hash_t* alpha, const uint64_t& alpha_size,
+              const hash_t* beta, const uint64_t& beta_size,
+              const uint64_t& k) {
     int i = 0;
     int j = 0;
 
     uint64_t common = 0;
     uint64_t denom;
 
-    while (i < alpha.size() && alpha[i] == 0) {
+    while (i < alpha_size && alpha[i] == 0) {
         i++;
     }
-    while (j < beta.size() && beta[j] == 0) {
+    while (j < beta_size && beta[j] == 0) {
         j++;
     }
     denom = i + j;
 
-    while (i < alpha.size() && j < beta.size()) {
+    while (i < alpha_size && j < beta_size) {
         if (alpha[i] == beta[j]) {
             i++;
             j++;
@@ -130,8 +133,8 @@ float compare(const std::vector<hash_t>& alpha, const std::vector<hash_t>& beta,
     }
 
     // complete the union operation
-    denom += alpha.size() - i;
-    denom += beta.size() - j;
+    denom += alpha_size - i;
+    denom += beta_size - j;
 
     float distance = 0.0;
 
@@ -7,46 +7,36 @@
 #include <unordered_set>
 #include <math.h>
 #include <algorithm>
+#include <cassert>
+#include <limits>
 #include "murmur3.hpp"
 
 // From Eric's https://github.com/edawson/rkmh
 
 namespace rkmh {
 
-// Crazy hack char table to test for canonical bases
-static const int valid_dna[127] = {
-        1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 0, 1, 0, 1, 1, 1,
-        0, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 0, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1, 0, 1, 0, 1,
-        1, 1, 0, 1, 1, 1, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 0, 1, 1, 1, 1,
-        1, 1, 1, 1, 1, 1
-};
-
-// Reverse complement lookup table
-static char rev_arr[26] = {
-        84, 66, 71, 68, 69,
-        70, 67, 72, 73, 74,
-        75, 76, 77, 78, 79,
-        80, 81, 82, 83, 65,
-        85, 86, 87, 88, 89, 90
-};
-
 typedef uint32_t hash_t;
 
-std::vector<hash_t> hash_sequence(const char* seq,
-                                  const uint64_t& len,
-                                  const uint64_t& k,
-                                  const uint64_t& sketch_size);
-
-float compare(const std::vector<hash_t>& alpha, const std::vector<hash_t>& beta, const uint64_t& k);
+// whether seq has a kmer of length k without non-ACGT bases, i.e. a non-empty
+// sketch
+bool has_valid_kmer(const char* seq, const uint64_t& len, const uint64_t& k);
+
+// the canonical hash of the kmer starting at each position of seq, or the max
+// hash if it contains non-ACGT bases
+std::vector<hash_t> hash_kmers(const char* seq,
+                               const uint64_t& len,
+                               const uint64_t& k);
+
+// write the sorted bottom-k sketch of a range of kmer hashes to sketch (room
+// for sketch_size hashes), using buffer as scratch space; returns its size
+uint64_t sketch_kmers(const hash_t* kmer_hashes,
+                      const uint64_t& num_kmers,
+                      const uint64_t& sketch_size,
+                      std::vector<hash_t>& buffer,
+                      hash_t* sketch);
+
+float compare(const hash_t* alpha, const uint64_t& alpha_size,
+              const hash_t* beta, const uint64_t& beta_size,
+              const uint64_t& k);
 
 }
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace wflign {
+
+// A stream of alignment operations ('M', 'X', 'I', 'D'), run-length encoded.
+// Consecutive equal operations are always merged into a single run, so the
+// runs are exactly the CIGAR blocks of the stream.
+class rle_cigar_t {
+public:
+    struct run_t {
+        char op;
+        uint64_t len;
+    };
+
+    // walks the stream one operation at a time, or a run at a time
+    class const_iterator {
+    public:
+        const_iterator(const run_t *run, const uint64_t &offset)
+            : run(run), offset(offset) {}
+        char operator*() const { return run->op; }
+        const_iterator &operator++() {
+            if (++offset == run->len) {
+                ++run;
+                offset = 0;
+            }
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator it = *this;
+            ++*this;
+            return it;
+        }
+        // operations left in the current run, including the current one
+        uint64_t remaining() const { return run->len - offset; }
+        // advance by n <= remaining() operations
+        void advance(const uint64_t &n) {
+            offset += n;
+            if (offset == run->len) {
+                ++run;
+                offset = 0;
+            }
+        }
+        bool operator==(const const_iterator &other) const {
+            return run == other.run && offset == other.offset;
+        }
+        bool operator!=(const const_iterator &other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const run_t *run;
+        uint64_t offset;
+    };
+
+    const_iterator begin() const { return {runs_.data(), 0}; }
+    const_iterator end() const { return {runs_.data() + runs_.size(), 0}; }
+
+    const std::vector<run_t> &runs() const { return runs_; }
+    bool empty() const { return runs_.empty(); }
+    // number of operations
+    uint64_t size() const { return size_; }
+    void clear() {
+        runs_.clear();
+        size_ = 0;
+    }
+
+    void push_back(const char &op, const uint64_t &n = 1) {
+        if (n == 0) {
+            return;
+        }
+        if (!runs_.empty() && runs_.back().op == op) {
+            runs_.back().len += n;
+        } else {
+            runs_.push_back({op, n});
+        }
+        size_ += n;
+    }
+    char back() const { return runs_.back().op; }
+    void pop_back() {
+        if (--runs_.back().len == 0) {
+            runs_.pop_back();
+        }
+        --size_;
+    }
+
+    // normalize: within each block of consecutive indels put the Is before
+    // the Ds, leaving everything else as-is
+    void sort_indels() {
+        std::vector<run_t> runs;
+        runs.reserve(runs_.size());
+        uint64_t ins = 0;
+        uint64_t dels = 0;
+        auto flush_indels = [&]() {
+            if (ins) runs.push_back({'I', ins});
+            if (dels) runs.push_back({'D', dels});
+            ins = dels = 0;
+        };
+        for (const auto &run : runs_) {
+            if (run.op == 'I') {
+                ins += run.len;
+            } else if (run.op == 'D') {
+                dels += run.len;
+            } else {
+                flush_indels();
+                runs.push_back(run);
+            }
+        }
+        flush_indels();
+        runs_.swap(runs);
+    }
+
+    // put the Ds before the Is in the leading block of indels
+    void sort_leading_indels() {
+        uint64_t ins = 0;
+        uint64_t dels = 0;
+        std::size_t x = 0;
+        for (; x < runs_.size() && (runs_[x].op == 'I' || runs_[x].op == 'D'); ++x) {
+            (runs_[x].op == 'I' ? ins : dels) += runs_[x].len;
+        }
+        std::vector<run_t> block;
+        if (dels) block.push_back({'D', dels});
+        if (ins) block.push_back({'I', ins});
+        runs_.erase(runs_.begin(), runs_.begin() + x);
+        runs_.insert(runs_.begin(), block.begin(), block.end());
+    }
+
+    // number of leading / trailing operations equal to op
+    uint64_t leading(const char &op) const {
+        return !runs_.empty() && runs_.front().op == op ? runs_.front().len : 0;
+    }
+    uint64_t trailing(const char &op) const {
+        return !runs_.empty() && runs_.back().op == op ? runs_.back().len : 0;
+    }
+
+    // drop n_front operations from the front and n_back from the back; each
+    // must lie within the first / last run
+    void trim(const uint64_t &n_front, const uint64_t &n_back) {
+        if (n_back) {
+            runs_.back().len -= n_back;
+            size_ -= n_back;
+            if (runs_.back().len == 0) {
+                runs_.pop_back();
+            }
+        }
+        if (n_front) {
+            runs_.front().len -= n_front;
+            size_ -= n_front;
+            if (runs_.front().len == 0) {
+                runs_.erase(runs_.begin());
+            }
+        }
+    }
+
+    // one byte per operation
+    std::vector<char> expand() const {
+        std::vector<char> ops;
+        ops.reserve(size_);
+        for (const auto &run : runs_) {
+            ops.insert(ops.end(), run.len, run.op);
+        }
+        return ops;
+    }
+
+private:
+    std::vector<run_t> runs_;
+    uint64_t size_ = 0;
+};
+
+} // namespace wflign
@@ -8,12 +8,143 @@ namespace wflign {
 
 namespace wavefront {
 
+// a pool of aligners owned by one thread, freed when the thread exits. An
+// aligner keeps the memory of the largest alignment it ran, so one handed
+// back above max_retained_size is freed rather than kept for the next user
+template <typename aligner_t, typename key_t>
+struct aligner_pool_t {
+    struct entry_t {
+        key_t key;
+        aligner_t* aligner;
+        bool in_use;
+    };
+    static constexpr uint64_t max_retained_size = 64 << 20;
+
+    std::vector<entry_t> entries;
+    void (*const delete_aligner)(aligner_t* const);
+    uint64_t (*const aligner_size)(aligner_t* const);
+
+    aligner_pool_t(void (*const delete_aligner)(aligner_t* const),
+                   uint64_t (*const aligner_size)(aligner_t* const))
+        : delete_aligner(delete_aligner), aligner_size(aligner_size) {}
+
+    ~aligner_pool_t() {
+        for (auto& entry : entries) {
+            delete_aligner(entry.aligner);
+        }
+    }
+
+    aligner_t* acquire(const key_t& key) {
+        for (auto& entry : entries) {
+            if (!entry.in_use && entry.key == key) {
+                entry.in_use = true;
+                return entry.aligner;
+            }
+        }
+        return nullptr;
+    }
+
+    void add(const key_t& key, aligner_t* const aligner) {
+        entries.push_back({key, aligner, true});
+    }
+
+    void release(aligner_t* const aligner) {
+        for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+            if (entry->aligner == aligner) {
+                if (aligner_size(aligner) > max_retained_size) {
+                    delete_aligner(aligner);
+                    entries.erase(entry);
+                } else {
+                    entry->in_use = false;
+                }
+                return;
+            }
+        }
+        // not pooled on this thread
+        delete_aligner(aligner);
+    }
+};
+
+struct wfa_aligner_key_t {
+    int match;
+    int mismatch;
+    int gap_opening;
+    int gap_extension;
+    bool low_memory;
+    bool operator==(const wfa_aligner_key_t& other) const {
+        return match == other.match && mismatch == other.mismatch
+            && gap_opening == other.gap_opening && gap_extension == other.gap_extension
+            && low_memory == other.low_memory;
+    }
+};
+
+struct wflambda_aligner_key_t {
+    int match;
+    int mismatch;
+    int gap_opening;
+    int gap_extension;
+    int min_wavefront_length;
+    int max_distance_threshold;
+    bool operator==(const wflambda_aligner_key_t& other) const {
+        return match == other.match && mismatch == other.mismatch
+            && gap_opening == other.gap_opening && gap_extension == other.gap_extension
+            && min_wavefront_length == other.min_wavefront_length
+            && max_distance_threshold == other.max_distance_threshold;
+    }
+};
+
+static void delete_wfa_aligner(wfa::wavefront_aligner_t* const wf_aligner) {
+    wfa::wavefront_aligner_delete(wf_aligner);
+}
+
+static void delete_wflambda_aligner(wflambda::wavefront_aligner_t* const wflambda_aligner) {
+    wflambda::wavefront_aligner_delete(wflambda_aligner);
+}
+
+// what the allocator of an aligner holds, freed or not: allocators keep their
+// memory until they are deleted
+template <typename mm_allocator_t, typename get_occupation_t>
+static uint64_t allocator_size(mm_allocator_t* const mm_allocator, get_occupation_t get_occupation) {
+    uint64_t used_malloc, used_allocator, free_available, free_fragmented;
+    get_occupation(mm_allocator, &used_malloc, &used_allocator, &free_available, &free_fragmented);
+    return used_malloc + used_allocator + free_available + free_fragmented;
+}
+
+static uint64_t wfa_aligner_size(wfa::wavefront_aligner_t* const wf_aligner) {
+    return allocator_size(wf_aligner->mm_allocator, wfa::mm_allocator_get_occupation);
+}
+
+static uint64_t wflambda_aligner_size(wflambda::wavefront_aligner_t* const wflambda_aligner) {
+    return allocator_size(wflambda_aligner->mm_allocator, wflambda::mm_allocator_get_occupation);
+}
+
+static thread_local aligner_pool_t<wfa::wavefront_aligner_t, wfa_aligner_key_t>
+    wfa_aligner_pool(delete_wfa_aligner, wfa_aligner_size);
+static thread_local aligner_pool_t<wflambda::wavefront_aligner_t, wflambda_aligner_key_t>
+    wflambda_aligner_pool(delete_wflambda_aligner, wflambda_aligner_size);
+
 wfa::wavefront_aligner_t* get_wavefront_aligner(
     const wfa::affine_penalties_t& wfa_affine_penalties,
     //ToDo: to remove if wavefront_aligner_new will not re-take the seqs' lens in input
     const uint64_t& target_length,
     const uint64_t& query_length,
     const bool& low_memory) {
+    const wfa_aligner_key_t key = {
+        wfa_affine_penalties.match, wfa_affine_penalties.mismatch,
+        wfa_affine_penalties.gap_opening, wfa_affine_penalties.gap_extension,
+        low_memory};
+    wfa::wavefront_aligner_t* const pooled = wfa_aligner_pool.acquire(key);
+    if (pooled != nullptr) {
+        // undo what the previous user configured; wavefront_align resizes
+        // (and clears) the aligner itself
+        wfa::wavefront_aligner_set_alignment_end_to_end(pooled);
+        wfa::wavefront_aligner_set_max_alignment_score(pooled, INT_MAX);
+        wfa::wavefront_reduction_set_none(&pooled->reduction);
+        wfa::wavefront_aligner_set_max_memory_used(pooled, UINT64_MAX);
+        wfa::wavefront_aligner_set_bidirectional(pooled, false);
+        return pooled;
+    }
+
     // Configure the attributes of the wf-aligner
     wfa::wavefront_aligner_attr_t attributes =
         wfa::wavefront_aligner_attr_default;
@@ -30,10 +161,77 @@ wfa::wavefront_aligner_t* get_wavefront_aligner(
     attributes.low_memory = low_memory;
     //wfa::wavefront_aligner_t *const wf_aligner =
     //return wfa::wavefront_aligner_new(target_length, query_length, &attributes);
-    return wfa::wavefront_aligner_new(&attributes);
+    wfa::wavefront_aligner_t* const wf_aligner = wfa::wavefront_aligner_new(&attributes);
+    wfa_aligner_pool.add(key, wf_aligner);
+    return wf_aligner;
 }
 
-#define MAX_LEN_FOR_PURE_WFA 50000
+void release_wavefront_aligner(wfa::wavefront_aligner_t* const wf_aligner) {
+    wfa_aligner_pool.release(wf_aligner);
+}
+
+int wfa_align_within_memory(wfa::wavefront_aligner_t *const wf_aligner,
+                            const char *pattern, const int &pattern_length,
+                            const char *text, const int &text_length,
+                            const uint64_t &max_memory) {
+    if (max_memory == 0) {
+        return wfa::wavefront_align(wf_aligner, pattern, pattern_length, text, text_length);
+    }
+    wfa::wavefront_aligner_set_max_memory_used(wf_aligner, max_memory);
+    int status = wfa::wavefront_align(wf_aligner, pattern, pattern_length, text, text_length);
+    if (status == WF_ALIGN_OOM) {
+        // give back what the aborted attempt allocated before going bidirectional
+        wfa::wavefront_aligner_reap(wf_aligner);
+        wfa::wavefront_aligner_set_bidirectional(wf_aligner, true);
+        status = wfa::wavefront_align(wf_aligner, pattern, pattern_length, text, text_length);
+        wfa::wavefront_aligner_set_bidirectional(wf_aligner, false);
+    }
+    wfa::wavefront_aligner_set_max_memory_used(wf_aligner, UINT64_MAX);
+    return status;
+}
+
+wflambda::wavefront_aligner_t* get_wflambda_aligner(
+    const wflambda::affine_penalties_t& wflambda_affine_penalties,
+    const int& min_wavefront_length,
+    const int& max_distance_threshold,
+    const int& pattern_length,
+    const int& text_length) {
+    const wflambda_aligner_key_t key = {
+        wflambda_affine_penalties.match, wflambda_affine_penalties.mismatch,
+        wflambda_affine_penalties.gap_opening, wflambda_affine_penalties.gap_extension,
+        min_wavefront_length, max_distance_threshold};
+    wflambda::wavefront_aligner_t* const pooled = wflambda_aligner_pool.acquire(key);
+    if (pooled != nullptr) {
+        return pooled;
+    }
+
+    // Configure the attributes of the wflambda-aligner
+    wflambda::wavefront_aligner_attr_t attributes =
+            wflambda::wavefront_aligner_attr_default;
+    attributes.distance_metric = wflambda::gap_affine;
+    attributes.affine_penalties = wflambda_affine_penalties;
+    // attributes.distance_metric = gap_affine2p;
+    // attributes.affine2p_penalties = affine2p_penalties;
+    if (min_wavefront_length || max_distance_threshold) {
+        attributes.reduction.reduction_strategy =
+                wflambda::wavefront_reduction_dynamic; // wavefront_reduction_dynamic
+        attributes.reduction.min_wavefront_length = min_wavefront_length;
+        attributes.reduction.max_distance_threshold = max_distance_threshold;
+    } else {
+        attributes.reduction.reduction_strategy =
+                wflambda::wavefront_reduction_none; // wavefront_reduction_dynamic
+    }
+    attributes.alignment_scope = wflambda::alignment_scope_alignment; // alignment_scope_score
+    attributes.low_memory = true;
+    wflambda::wavefront_aligner_t* const wflambda_aligner = wflambda::wavefront_aligner_new(
+            pattern_length, text_length, &attributes);
+    wflambda_aligner_pool.add(key, wflambda_aligner);
+    return wflambda_aligner;
+}
+
+void release_wflambda_aligner(wflambda::wavefront_aligner_t* const wflambda_aligner) {
+    wflambda_aligner_pool.release(wflambda_aligner);
+}
 
 void wflign_affine_wavefront(
     std::ostream &out,
@@ -58,7 +256,11 @@ void wflign_affine_wavefront(
     const int &wflign_gap_extension_score,
     const float &wflign_max_mash_dist,
     const uint64_t &wflign_max_len_major, const uint64_t &wflign_max_len_minor,
-    const uint16_t &erode_k) {
+    const uint16_t &erode_k,
+    const uint64_t &wflign_chunk_length, const uint64_t &wflign_max_memory,
+    task_pool_t *const task_pool,
+    segment_sketch_cache_t *const query_sketch_cache,
+    merged_alignment_t *const result) {
     // const int& wfa_min_wavefront_length, // with these set at 0 we do exact
     // WFA for WFA itself const int& wfa_max_distance_threshold) {
 
@@ -143,12 +345,24 @@ void wflign_affine_wavefront(
                                               min_wf_length,
                                               max_dist_threshold);
 
+        // give up as soon as the score says we can't reach min_identity
+        const int max_score = wfa_identity_score_bound(min_identity, query_length, target_length,
+                                                       wfa_affine_penalties);
+        wfa::wavefront_aligner_set_max_alignment_score(wf_aligner, max_score);
+
         auto *aln = new alignment_t();
         wfa::wavefront_aligner_resize(wf_aligner, target_length, query_length);
 
-        const int status = wfa::wavefront_align(wf_aligner,
-                                                target, target_length,
-                                                query, query_length);
+        const int status = wfa_align_within_memory(wf_aligner,
+                                                   target, target_length,
+                                                   query, query_length,
+                                                   wflign_max_memory);
+        if (status == WF_ALIGN_MAX_SCORE && max_score != INT_MAX) {
+            // hopeless
+            delete aln;
+            release_wavefront_aligner(wf_aligner);
+            return;
+        }
 
         aln->j = 0;
         aln->i = 0;
@@ -211,20 +425,16 @@ void wflign_affine_wavefront(
                 num_alignments_performed, mashmap_estimated_identity,
                 wflign_max_len_major, wflign_max_len_minor,
                 erode_k,
-                min_wf_length, max_dist_threshold);
+                min_wf_length, max_dist_threshold,
+                wflign_max_memory, task_pool, result);
 
         // Free
-        wfa::wavefront_aligner_delete(wf_aligner);
+        release_wavefront_aligner(wf_aligner);
     } else {
         if (emit_tsv) {
-            out_tsv << "# query_name=" << query_name << std::endl;
-            out_tsv << "# query_start=" << query_offset << std::endl;
-            out_tsv << "# query_end=" << query_offset+query_length << std::endl;
-            out_tsv << "# target_name=" << target_name << std::endl;
-            out_tsv << "# target_start=" << target_offset << std::endl;
-            out_tsv << "# target_end=" << target_offset+target_length << std::endl;
-            out_tsv << "# info: 0) mismatch, mash-distance > threshold; 1) mismatch, WFA-score >= max_score; 2) match, WFA-score < max_score" << std::endl;
-            out_tsv << "v" << "\t" << "h" << "\t" << "info" << std::endl;
+            wavefront_info_encoder_t::header(out_tsv,
+                                             query_name, query_offset, query_offset + query_length,
+                                             target_name, target_offset, target_offset + target_length);
         }
 
         const uint16_t segment_length_to_use =
@@ -236,18 +446,6 @@ void wflign_affine_wavefront(
         const uint8_t steps_per_segment = 2;
         const uint16_t step_size = segment_length_to_use / steps_per_segment;
 
-        // Pattern & Text
-        // If the query_length/target_length are not multiple of step_size, we count
-        // a fragment less, and the last one will be longer than segment_length_to_use
-        const int pattern_length = (int)query_length / step_size - (query_length % step_size != 0 ? 1 : 0);
-        const int text_length = (int)target_length / step_size - (target_length % step_size != 0 ? 1 : 0);
-
-        // uncomment to use reduced WFA locally
-        // currently not supported due to issues with traceback when applying
-        // WF-reduction on small problems
-        const int wfa_min_wavefront_length = 0; // segment_length_to_use / 16;
-        const int wfa_max_distance_threshold = 0; // segment_length_to_use / 8;
-
         wflambda::affine_penalties_t wflambda_affine_penalties;
         if (wfa_mismatch_score > 0 && wfa_gap_opening_score > 0 && wfa_gap_extension_score > 0){
             wflambda_affine_penalties = {
@@ -318,156 +516,109 @@ void wflign_affine_wavefront(
         //std::cerr << "wflambda_affine_penalties.gap_extension " << wflambda_affine_penalties.gap_extension << std::endl;
         //std::cerr << "max_mash_dist_to_evaluate " << max_mash_dist_to_evaluate << std::endl;
 
-        // Configure the attributes of the wflambda-aligner
-        wflambda::wavefront_aligner_attr_t attributes =
-                wflambda::wavefront_aligner_attr_default;
-        attributes.distance_metric = wflambda::gap_affine;
-        attributes.affine_penalties = wflambda_affine_penalties;
-        // attributes.distance_metric = gap_affine2p;
-        // attributes.affine2p_penalties = affine2p_penalties;
-        if (wflambda_min_wavefront_length || wflambda_max_distance_threshold) {
-            attributes.reduction.reduction_strategy =
-                    wflambda::wavefront_reduction_dynamic; // wavefront_reduction_dynamic
-                    attributes.reduction.min_wavefront_length = wflambda_min_wavefront_length;
-                    attributes.reduction.max_distance_threshold = wflambda_max_distance_threshold;
-        } else {
-            attributes.reduction.reduction_strategy =
-                    wflambda::wavefront_reduction_none; // wavefront_reduction_dynamic
-        }
-        attributes.alignment_scope = wflambda::alignment_scope_alignment; // alignment_scope_score
-        attributes.low_memory = true;
-        wflambda::wavefront_aligner_t *const wflambda_aligner = wflambda::wavefront_aligner_new(
-                pattern_length, text_length, &attributes);
-
-
-        // save computed alignments in a pair-indexed map
-        robin_hood::unordered_flat_map<uint64_t, alignment_t *> alignments;
-
-        // allocate vectors to store our sketches
-        std::vector<std::vector<rkmh::hash_t> *> query_sketches(pattern_length,
-                                                                nullptr);
-        std::vector<std::vector<rkmh::hash_t> *> target_sketches(text_length,
-                                                                 nullptr);
-
         wfa::wavefront_aligner_t* const wf_aligner = get_wavefront_aligner(wfa_affine_penalties,
                                                                            segment_length_to_use,
                                                                            segment_length_to_use,
                                                                            false);
 
-        int v_max = 0;
-        int h_max = 0;
-
-        // heuristic bound on the max mash dist, adaptive based on estimated
-        // identity the goal here is to sparsify the set of alignments in the
-        // wflambda layer we then patch up the gaps between them
-        //const float max_mash_dist = std::max(0.05, (1.0 - mashmap_estimated_identity));
-
-        auto extend_match = [&](const int &v, const int &h) {
-            bool is_a_match = false;
-            if (v >= 0 && h >= 0 && v < pattern_length && h < text_length) {
-                const uint64_t k = encode_pair(v, h);
-                const auto f = alignments.find(k); // high-level of WF-inception
-                if (f != alignments.end()) {
-                    is_a_match = (alignments[k] != nullptr);
-                } else {
-                    const int query_begin = v * step_size;
-                    const int target_begin = h * step_size;
-
-                    // The last fragment can be longer than segment_length_to_use (max 2*segment_length_to_use - 1)
-                    const auto segment_length_to_use_q = (uint16_t) (v == pattern_length - 1 ? query_length - query_begin : segment_length_to_use);
-                    const auto segment_length_to_use_t = (uint16_t) (h == text_length - 1 ? target_length - target_begin : segment_length_to_use);
-
-                    auto *aln = new alignment_t();
-                    const bool alignment_performed = do_wfa_segment_alignment(
-                            query_name, query, query_sketches[v], query_length,
-                            query_begin, target_name, target, target_sketches[h],
-                            target_length, target_begin,
-                            segment_length_to_use_q,
-                            segment_length_to_use_t,
-                            step_size, minhash_kmer_size, wfa_min_wavefront_length,
-                            wfa_max_distance_threshold, max_mash_dist_to_evaluate, mashmap_estimated_identity,
-                            wf_aligner, &wfa_affine_penalties, *aln);
-                    if (emit_tsv) {
-                        // 0) Mis-match, alignment skipped
-                        // 1) Mis-match, alignment performed
-                        // 2) Match, alignment performed
-                        out_tsv << v << "\t" << h << "\t" << (alignment_performed ? (aln->ok ? 2 : 1) : 0) << std::endl;
-                    }
-                    ++num_alignments;
-                    if (alignment_performed) {
-                        ++num_alignments_performed;
-                        if (aln->ok){
-                            is_a_match = true;
-                            alignments[k] = aln;
-                        } else {
-                            alignments[k] = nullptr;
-                        }
-                    }
-                    if (!is_a_match) {
-                        delete aln;
-                    }
+        // very long mappings are split along the diagonal into overlapping chunks,
+        // aligned in parallel and then spliced together; chunks start on the
+        // wflambda grid, so that overlapping chunks evaluate the same cells
+        struct chunk_t {
+            uint64_t query_begin = 0;
+            uint64_t query_length = 0;
+            uint64_t target_begin = 0;
+            uint64_t target_length = 0;
+            std::vector<alignment_t *> trace;
+            uint64_t num_alignments = 0;
+            uint64_t num_alignments_performed = 0;
+            std::stringstream out_tsv;
+        };
 
-                    // cleanup old sketches
-                    if (v > v_max) {
-                        v_max = v;
-                        if (v >= wflambda_max_distance_threshold) {
-                            auto &s =
-                                    query_sketches[v - wflambda_max_distance_threshold];
-                            // The C++ language guarantees that delete p will do
-                            // nothing if p is equal to NULL
-                            delete s;
-                            s = nullptr;
-                        }
-                    }
-                    if (h > h_max) {
-                        h_max = h;
-                        if (h >= wflambda_max_distance_threshold) {
-                            auto &s =
-                                    target_sketches[h -
-                                    wflambda_max_distance_threshold];
-                            // The C++ language guarantees that delete p will do
-                            // nothing if p is equal to NULL
-                            delete s;
-                            s = nullptr;
-                        }
-                    }
-                }
-            } else if (h < 0 || v < 0) { // It can be removed using an edit-distance
-                // mode as high-level of WF-inception
-                is_a_match = true;
-            }
-            return is_a_match;
+        // forward-strand position of a point of the (possibly reversed) query,
+        // where the segments are found in the cache shared by its mappings
+        auto query_cache_origin = [&](const uint64_t &query_begin) {
+            return query_is_rev ? query_offset + query_length - query_begin : query_offset + query_begin;
         };
 
-        auto trace_match = [&](const int &v, const int &h) {
-            if (v >= 0 && h >= 0 && v < pattern_length && h < text_length) {
-                const uint64_t k = encode_pair(v, h);
-                const auto f = alignments.find(k);
-                if (f != alignments.end() && alignments[k] != nullptr) {
-                    auto *aln = alignments[k];
-                    trace.push_back(aln);
-                    aln->keep = true;
-                    ++num_alignments;
-                    return true;
+        uint64_t num_chunks = 1;
+        if (wflign_chunk_length > 0 && std::max(query_length, target_length) >= 2 * wflign_chunk_length) {
+            num_chunks = std::max(query_length, target_length) / wflign_chunk_length;
+            // each chunk has to span a few segments on both axes
+            num_chunks = std::max((uint64_t)1, std::min(num_chunks,
+                                                        std::min(query_length, target_length) / (4 * (uint64_t)segment_length_to_use)));
+        }
+
+        if (num_chunks == 1) {
+            do_wflambda_alignment(
+                    trace, num_alignments, num_alignments_performed,
+                    emit_tsv, out_tsv,
+                    query_name, query, 0, query_length,
+                    target_name, target, 0, target_length,
+                    segment_length_to_use, step_size, minhash_kmer_size,
+                    wflambda_min_wavefront_length, wflambda_max_distance_threshold,
+                    max_mash_dist_to_evaluate, mashmap_estimated_identity,
+                    &wflambda_affine_penalties, wf_aligner, &wfa_affine_penalties,
+                    query_sketch_cache, query_cache_origin(0), query_is_rev);
+        } else {
+            const uint64_t chunk_overlap = std::max(wflign_chunk_length / 32 / step_size, (uint64_t)8) * step_size;
+
+            std::vector<chunk_t> chunks(num_chunks);
+            auto boundary = [&](const uint64_t &length, const uint64_t &c) {
+                return c == num_chunks ? length : (length * c / num_chunks) / step_size * step_size;
+            };
+            for (uint64_t c = 0; c < num_chunks; ++c) {
+                auto &chunk = chunks[c];
+                chunk.query_begin = boundary(query_length, c) - std::min(chunk_overlap, boundary(query_length, c));
+                chunk.query_length = std::min(query_length, boundary(query_length, c + 1) + (c + 1 < num_chunks ? chunk_overlap : 0)) - chunk.query_begin;
+                chunk.target_begin = boundary(target_length, c) - std::min(chunk_overlap, boundary(target_length, c));
+                chunk.target_length = std::min(target_length, boundary(target_length, c + 1) + (c + 1 < num_chunks ? chunk_overlap : 0)) - chunk.target_begin;
+            }
+
+            const std::thread::id caller = std::this_thread::get_id();
+            const std::function<void(const uint64_t &)> align_chunk = [&](const uint64_t &c) {
+                // helpers take an aligner from their own pool
+                const bool on_caller = std::this_thread::get_id() == caller;
+                wfa::wavefront_aligner_t* const chunk_wf_aligner = on_caller ? wf_aligner
+                    : get_wavefront_aligner(wfa_affine_penalties,
+                                            segment_length_to_use,
+                                            segment_length_to_use,
+                                            false);
+                auto &chunk = chunks[c];
+                do_wflambda_alignment(
+                        chunk.trace, chunk.num_alignments, chunk.num_alignments_performed,
+                        emit_tsv, chunk.out_tsv,
+                        query_name, query, chunk.query_begin, chunk.query_length,
+                        target_name, target, chunk.target_begin, chunk.target_length,
+                        segment_length_to_use, step_size, minhash_kmer_size,
+                        wflambda_min_wavefront_length, wflambda_max_distance_threshold,
+                        max_mash_dist_to_evaluate, mashmap_estimated_identity,
+                        &wflambda_affine_penalties, chunk_wf_aligner, &wfa_affine_penalties,
+                        query_sketch_cache, query_cache_origin(chunk.query_begin), query_is_rev);
+                if (!on_caller) {
+                    release_wavefront_aligner(chunk_wf_aligner);
                 }
-                return false;
+            };
+            if (task_pool != nullptr) {
+                task_pool->run(num_chunks, align_chunk);
             } else {
-                return false;
+                for (uint64_t c = 0; c < num_chunks; ++c) {
+                    align_chunk(c);
+                }
             }
-        };
 
-        // Align
-        wflambda::wavefront_aligner_clear__resize(wflambda_aligner, pattern_length,
-                                                  text_length);
-        wflambda::wavefront_align(wflambda_aligner, extend_match,
-                                  trace_match, pattern_length, text_length);
-        wflambda::wavefront_aligner_delete(wflambda_aligner);
-
-        for (const auto &p : alignments) {
-            if (p.second != nullptr && !p.second->keep) {
-                delete p.second;
-                //p.second = nullptr;
+            // splice the chunks in alignment order, then restore the traceback order
+            std::vector<alignment_t *> spliced;
+            for (auto &chunk : chunks) {
+                std::vector<alignment_t *> chunk_trace(chunk.trace.rbegin(), chunk.trace.rend());
+                splice_chunk_traces(spliced, chunk_trace, chunk.query_begin, chunk.target_begin);
+                num_alignments += chunk.num_alignments;
+                num_alignments_performed += chunk.num_alignments_performed;
+                if (emit_tsv) {
+                    out_tsv << chunk.out_tsv.rdbuf();
+                }
             }
+            trace.assign(spliced.rbegin(), spliced.rend());
         }
 
         const long elapsed_time_wflambda_ms =
@@ -475,29 +626,6 @@ void wflign_affine_wavefront(
                         std::chrono::steady_clock::now() - start_time)
                         .count();
 
-        //#define WFLIGN_DEBUG
-        #ifdef WFLIGN_DEBUG
-        // get alignment score
-        const int score = wflambda::edit_cigar_score_gap_affine(
-                &affine_wavefronts->edit_cigar, &wflambda_affine_penalties);
-
-        std::cerr << "[wflign::wflign_affine_wavefront] alignment score " << score
-        << " for query: " << query_name << " target: " << target_name
-        << std::endl;
-        #endif
-
-        // clean up sketches
-        // The C++ language guarantees that delete p will do nothing if p is equal
-        // to NULL
-        for (auto &s : query_sketches) {
-            delete s;
-            s = nullptr;
-        }
-        for (auto &s : target_sketches) {
-            delete s;
-            s = nullptr;
-        }
-
         // todo: implement alignment identifier based on hash of the input, params,
         // and commit annotate each PAF record with it and the full alignment score
 
@@ -512,10 +640,6 @@ void wflign_affine_wavefront(
             }
             #endif
 
-            if(attributes.low_memory) {
-                std::reverse(trace.begin(), trace.end());
-            }
-
             auto x = trace.rbegin();
             auto end_trace = trace.rend();
 
@@ -648,7 +772,8 @@ void wflign_affine_wavefront(
                         num_alignments_performed, mashmap_estimated_identity,
                         wflign_max_len_major, wflign_max_len_minor,
                         erode_k,
-                        256, 4096);
+                        256, 4096,
+                        wflign_max_memory, task_pool, result);
             } else {
                 for (auto x = trace.rbegin(); x != trace.rend(); ++x) {
                     // std::cerr << "on alignment" << std::endl;
@@ -661,8 +786,269 @@ void wflign_affine_wavefront(
         }
 
         // Free
-        wfa::wavefront_aligner_delete(wf_aligner);
+        release_wavefront_aligner(wf_aligner);
+    }
+}
+
+// align the chunk [chunk_query_begin, chunk_query_begin + query_length) x
+// [chunk_target_begin, chunk_target_begin + target_length) of the mapping with
+// wflambda, filling the (empty) trace with the alignments on its traceback, in
+// traceback order (last alignment first) and in mapping coordinates
+void do_wflambda_alignment(
+    std::vector<alignment_t *> &trace,
+    uint64_t &num_alignments, uint64_t &num_alignments_performed,
+    const bool &emit_tsv, std::ostream &out_tsv,
+    const std::string &query_name, const char *query,
+    const uint64_t &chunk_query_begin, const uint64_t &query_length,
+    const std::string &target_name, const char *target,
+    const uint64_t &chunk_target_begin, const uint64_t &target_length,
+    const uint16_t &segment_length_to_use, const uint16_t &step_size,
+    const int &minhash_kmer_size,
+    const int &wflambda_min_wavefront_length,
+    const int &wflambda_max_distance_threshold,
+    const float &max_mash_dist_to_evaluate, const float &mashmap_estimated_identity,
+    wflambda::affine_penalties_t *const wflambda_affine_penalties,
+    wfa::wavefront_aligner_t *const wf_aligner,
+    wfa::affine_penalties_t *const wfa_affine_penalties,
+    segment_sketch_cache_t *const query_sketch_cache,
+    const uint64_t &query_cache_origin, const bool &query_is_rev) {
+    // Pattern & Text
+    // If the query_length/target_length are not multiple of step_size, we count
+    // a fragment less, and the last one will be longer than segment_length_to_use
+    const int pattern_length = (int)query_length / step_size - (query_length % step_size != 0 ? 1 : 0);
+    const int text_length = (int)target_length / step_size - (target_length % step_size != 0 ? 1 : 0);
+
+    // uncomment to use reduced WFA locally
+    // currently not supported due to issues with traceback when applying
+    // WF-reduction on small problems
+    const int wfa_min_wavefront_length = 0; // segment_length_to_use / 16;
+    const int wfa_max_distance_threshold = 0; // segment_length_to_use / 8;
+
+    wflambda::wavefront_aligner_t *const wflambda_aligner = get_wflambda_aligner(
+            *wflambda_affine_penalties,
+            wflambda_min_wavefront_length, wflambda_max_distance_threshold,
+            pattern_length, text_length);
+
+
+    // save computed alignments in a banded store
+    wflambda_cells_t alignments(pattern_length, text_length);
+
+    // the evaluated cells, for the wavefront information
+    wavefront_info_encoder_t tsv_encoder;
+
+    // hash both sides once, the segment sketches are sliced from these
+    segment_sketches_t query_sketches(query + chunk_query_begin, query_length,
+                                      pattern_length, segment_length_to_use,
+                                      step_size, minhash_kmer_size,
+                                      query_sketch_cache, query_cache_origin, query_is_rev);
+    segment_sketches_t target_sketches(target + chunk_target_begin, target_length,
+                                       text_length, segment_length_to_use,
+                                       step_size, minhash_kmer_size);
+
+    // heuristic bound on the max mash dist, adaptive based on estimated
+    // identity the goal here is to sparsify the set of alignments in the
+    // wflambda layer we then patch up the gaps between them
+    //const float max_mash_dist = std::max(0.05, (1.0 - mashmap_estimated_identity));
+
+    auto extend_match = [&](const int &v, const int &h) {
+        bool is_a_match = false;
+        if (v >= 0 && h >= 0 && v < pattern_length && h < text_length) {
+            uint32_t &cell = alignments(v, h); // high-level of WF-inception
+            if (cell != wflambda_cells_t::unevaluated) {
+                is_a_match = (cell != wflambda_cells_t::mismatch);
+            } else {
+                const int query_begin = v * step_size;
+                const int target_begin = h * step_size;
+
+                // The last fragment can be longer than segment_length_to_use (max 2*segment_length_to_use - 1)
+                const auto segment_length_to_use_q = (uint16_t) (v == pattern_length - 1 ? query_length - query_begin : segment_length_to_use);
+                const auto segment_length_to_use_t = (uint16_t) (h == text_length - 1 ? target_length - target_begin : segment_length_to_use);
+
+                const uint32_t aln_cell = alignments.add_alignment();
+                auto *aln = alignments.alignment(aln_cell);
+                // identical segments (most of them, between haplotypes) skip minhash and WFA
+                bool alignment_performed = do_identical_segment_alignment(
+                        query, chunk_query_begin + query_begin,
+                        target, chunk_target_begin + target_begin,
+                        segment_length_to_use_q, segment_length_to_use_t,
+                        minhash_kmer_size, *aln);
+                if (!alignment_performed) {
+                    uint64_t query_sketch_size;
+                    uint64_t target_sketch_size;
+                    const rkmh::hash_t *query_sketch = query_sketches.get(v, segment_length_to_use_q, query_sketch_size);
+                    const rkmh::hash_t *target_sketch = target_sketches.get(h, segment_length_to_use_t, target_sketch_size);
+
+                    alignment_performed = do_wfa_segment_alignment(
+                            query_name, query, query_sketch, query_sketch_size,
+                            chunk_query_begin + query_begin, target_name, target,
+                            target_sketch, target_sketch_size,
+                            chunk_target_begin + target_begin,
+                            segment_length_to_use_q,
+                            segment_length_to_use_t,
+                            step_size, minhash_kmer_size, wfa_min_wavefront_length,
+                            wfa_max_distance_threshold, max_mash_dist_to_evaluate, mashmap_estimated_identity,
+                            wf_aligner, wfa_affine_penalties, *aln);
+                }
+                if (emit_tsv) {
+                    // 0) Mis-match, alignment skipped
+                    // 1) Mis-match, alignment performed
+                    // 2) Match, alignment performed
+                    tsv_encoder.cell(out_tsv, chunk_query_begin / step_size + v, chunk_target_begin / step_size + h, alignment_performed ? (aln->ok ? 2 : 1) : 0);
+                }
+                ++num_alignments;
+                if (alignment_performed) {
+                    ++num_alignments_performed;
+                    if (aln->ok){
+                        is_a_match = true;
+                        cell = aln_cell;
+                    } else {
+                        cell = wflambda_cells_t::mismatch;
+                    }
+                }
+                if (!is_a_match) {
+                    alignments.slab.pop_back();
+                }
+            }
+        } else if (h < 0 || v < 0) { // It can be removed using an edit-distance
+            // mode as high-level of WF-inception
+            is_a_match = true;
+        }
+        return is_a_match;
+    };
+
+    auto trace_match = [&](const int &v, const int &h) {
+        if (v >= 0 && h >= 0 && v < pattern_length && h < text_length) {
+            const uint32_t cell = alignments.get(v, h);
+            if (cell != wflambda_cells_t::unevaluated && cell != wflambda_cells_t::mismatch) {
+                auto *aln = alignments.alignment(cell);
+                trace.push_back(aln);
+                aln->keep = true;
+                ++num_alignments;
+                return true;
+            }
+            return false;
+        } else {
+            return false;
+        }
+    };
+
+    // Align
+    wflambda::wavefront_aligner_clear__resize(wflambda_aligner, pattern_length,
+                                              text_length);
+    wflambda::wavefront_align(wflambda_aligner, extend_match,
+                              trace_match, pattern_length, text_length);
+    release_wflambda_aligner(wflambda_aligner);
+
+    // the trace owns the alignments it keeps, the rest go with the slab
+    for (auto &aln : trace) {
+        aln = wflambda_cells_t::release(aln);
+    }
+
+    //#define WFLIGN_DEBUG
+    #ifdef WFLIGN_DEBUG
+    // get alignment score
+    const int score = wflambda::edit_cigar_score_gap_affine(
+            &affine_wavefronts->edit_cigar, wflambda_affine_penalties);
+
+    std::cerr << "[wflign::wflign_affine_wavefront] alignment score " << score
+    << " for query: " << query_name << " target: " << target_name
+    << std::endl;
+    #endif
+
+    // the low-memory traceback (used by pooled wflambda aligners) collects the
+    // alignments in order, while the caller expects them in traceback order
+    // (last alignment first)
+    std::reverse(trace.begin(), trace.end());
+}
+
+int wfa_identity_score_bound(const float &min_identity,
+                             const uint64_t &query_length,
+                             const uint64_t &target_length,
+                             const wfa::affine_penalties_t &penalties) {
+    if (min_identity <= 0) {
+        return INT_MAX;
     }
+    // the gap-compressed identity counts each mismatch and gap once, so an
+    // alignment reaching min_identity has at most this many of them (there
+    // are at most min(query_length, target_length) matches)
+    const double max_events = std::ceil((double)std::min(query_length, target_length) *
+                                        (1.0 - min_identity) / min_identity);
+    // each costs at most a mismatch or a gap opening, and the gaps together
+    // extend over at most query_length + target_length bases
+    const double bound = max_events * std::max(penalties.mismatch, penalties.gap_opening) +
+                         (double)(query_length + target_length) * penalties.gap_extension;
+    return bound >= (double)INT_MAX ? INT_MAX : (int)bound;
+}
+
+void splice_chunk_traces(std::vector<alignment_t *> &trace,
+                         std::vector<alignment_t *> &chunk_trace,
+                         const uint64_t &chunk_query_begin,
+                         const uint64_t &chunk_target_begin) {
+    if (chunk_trace.empty()) {
+        return;
+    }
+    if (trace.empty()) {
+        trace.swap(chunk_trace);
+        return;
+    }
+
+    // cells of the previous chunks inside the overlap with this one
+    robin_hood::unordered_flat_map<uint64_t, uint64_t> overlapping;
+    for (uint64_t x = trace.size(); x-- > 0;) {
+        const auto &aln = *trace[x];
+        if (aln.j < chunk_query_begin || aln.i < chunk_target_begin) {
+            break;
+        }
+        overlapping[encode_pair(aln.j, aln.i)] = x;
+    }
+
+    const uint64_t overlap_end = trace.back()->j + trace.back()->query_length;
+    const uint64_t overlap_mid = (chunk_query_begin + std::max((uint64_t)chunk_query_begin, overlap_end)) / 2;
+
+    // anchor on the cell that both sides put on their traceback, closest to the
+    // middle of the overlap, where neither chunk is constrained by its ends
+    uint64_t anchor_x = 0, anchor_y = 0;
+    uint64_t best_dist = std::numeric_limits<uint64_t>::max();
+    for (uint64_t y = 0; y < chunk_trace.size(); ++y) {
+        const auto &aln = *chunk_trace[y];
+        const auto f = overlapping.find(encode_pair(aln.j, aln.i));
+        if (f != overlapping.end()
+            && trace[f->second]->query_length == aln.query_length
+            && trace[f->second]->target_length == aln.target_length) {
+            const uint64_t dist = aln.j > overlap_mid ? aln.j - overlap_mid : overlap_mid - aln.j;
+            if (dist < best_dist) {
+                best_dist = dist;
+                anchor_x = f->second;
+                anchor_y = y;
+            }
+        }
+    }
+
+    uint64_t first_y = 0;
+    if (best_dist != std::numeric_limits<uint64_t>::max()) {
+        // the anchor is the same alignment on both sides, keep the previous one
+        for (uint64_t x = anchor_x + 1; x < trace.size(); ++x) {
+            delete trace[x];
+        }
+        trace.resize(anchor_x + 1);
+        while (first_y <= anchor_y) {
+            delete chunk_trace[first_y++];
+        }
+    } else {
+        // no agreement: cut in the middle of the overlap and let the patching
+        // fill the gap between the two sides
+        while (!trace.empty() && trace.back()->j >= overlap_mid) {
+            delete trace.back();
+            trace.pop_back();
+        }
+        while (first_y < chunk_trace.size() && !trace.empty() &&
+               (chunk_trace[first_y]->j < trace.back()->j + trace.back()->query_length ||
+                chunk_trace[first_y]->i < trace.back()->i + trace.back()->target_length)) {
+            delete chunk_trace[first_y++];
+        }
+    }
+    trace.insert(trace.end(), chunk_trace.begin() + first_y, chunk_trace.end());
+    chunk_trace.clear();
 }
 
 // accumulate alignment objects
@@ -672,9 +1058,9 @@ void wflign_affine_wavefront(
 //     --- trim the alignment back to the first 1/2 of the query
 bool do_wfa_segment_alignment(
     const std::string &query_name, const char *query,
-    std::vector<rkmh::hash_t> *&query_sketch, const uint64_t &query_length,
+    const rkmh::hash_t *query_sketch, const uint64_t &query_sketch_size,
     const uint64_t &j, const std::string &target_name, const char *target,
-    std::vector<rkmh::hash_t> *&target_sketch, const uint64_t &target_length,
+    const rkmh::hash_t *target_sketch, const uint64_t &target_sketch_size,
     const uint64_t &i,
     const uint16_t &segment_length_q,
     const uint16_t &segment_length_t,
@@ -684,21 +1070,10 @@ bool do_wfa_segment_alignment(
     wfa::wavefront_aligner_t *const wf_aligner,
     wfa::affine_penalties_t *const affine_penalties, alignment_t &aln) {
 
-    // first make the sketches if we haven't yet
-    if (query_sketch == nullptr) {
-        query_sketch = new std::vector<rkmh::hash_t>();
-        *query_sketch = rkmh::hash_sequence(
-            query + j, segment_length_q, minhash_kmer_size, segment_length_q / 20);
-    }
-    if (target_sketch == nullptr) {
-        target_sketch = new std::vector<rkmh::hash_t>();
-        *target_sketch = rkmh::hash_sequence(
-            target + i, segment_length_t, minhash_kmer_size, segment_length_t / 20);
-    }
-
     // first check if our mash dist is inbounds
     const float mash_dist =
-        rkmh::compare(*query_sketch, *target_sketch, minhash_kmer_size);
+        rkmh::compare(query_sketch, query_sketch_size,
+                      target_sketch, target_sketch_size, minhash_kmer_size);
 
     // this threshold is set low enough that we tend to randomly sample wflambda
     // matrix cells for alignment the threshold is adaptive, based on the mash
@@ -719,9 +1094,7 @@ bool do_wfa_segment_alignment(
 //                                     ceil((float) segment_length_div_4 * 3 * (1.0 - mashmap_estimated_identity)) *
 //                                     (float) (affine_penalties->gap_opening + affine_penalties->gap_extension + affine_penalties->mismatch));
 
-        wfa::wavefront_aligner_resize(wf_aligner, segment_length_t,
-                                             segment_length_q);
-
+        // wavefront_align resizes (and clears) the aligner itself
         wfa::wavefront_aligner_set_max_alignment_score(wf_aligner, max_score);
         const int status =
             wfa::wavefront_align(wf_aligner, target + i, segment_length_t,
@@ -771,6 +1144,39 @@ bool do_wfa_segment_alignment(
     }
 }
 
+bool do_identical_segment_alignment(const char *query, const uint64_t &j,
+                                    const char *target, const uint64_t &i,
+                                    const uint16_t &segment_length_q,
+                                    const uint16_t &segment_length_t,
+                                    const uint64_t &minhash_kmer_size,
+                                    alignment_t &aln) {
+    if (segment_length_q != segment_length_t
+        || memcmp(query + j, target + i, segment_length_q) != 0) {
+        return false;
+    }
+    // without a sketch (too short, or no kmer of ACGT bases only, as in runs
+    // of N) the mash distance is 1 and the segments are never aligned
+    if (segment_length_q / 20 == 0
+        || !rkmh::has_valid_kmer(query + j, segment_length_q, minhash_kmer_size)) {
+        return false;
+    }
+
+    aln.j = j;
+    aln.i = i;
+    aln.query_length = segment_length_q;
+    aln.target_length = segment_length_t;
+    aln.ok = true;
+
+    aln.edit_cigar.max_operations = segment_length_q;
+    aln.edit_cigar.begin_offset = 0;
+    aln.edit_cigar.end_offset = segment_length_q;
+    aln.edit_cigar.score = 0;
+    aln.edit_cigar.operations = (char *)malloc(segment_length_q);
+    memset(aln.edit_cigar.operations, 'M', segment_length_q);
+
+    return true;
+}
+
 void do_wfa_patch_alignment(const char *query, const uint64_t &j,
                             const uint64_t &query_length, const char *target,
                             const uint64_t &i, const uint64_t &target_length,
@@ -779,6 +1185,7 @@ void do_wfa_patch_alignment(const char *query, const uint64_t &j,
                             const int &max_distance_threshold,
                             wfa::wavefront_aligner_t *const _wf_aligner,
                             wfa::affine_penalties_t *const affine_penalties,
+                            const uint64_t &max_memory,
                             alignment_t &aln) {
     const long max_seg_len = 3 * segment_length;
     const bool big_wave = (query_length > max_seg_len || target_length > max_seg_len);
@@ -828,8 +1235,8 @@ void do_wfa_patch_alignment(const char *query, const uint64_t &j,
 
     wfa::wavefront_aligner_set_max_alignment_score(wf_aligner, max_score);
     const int status =
-        wfa::wavefront_align(wf_aligner, target + i, target_length,
-                                     query + j, query_length);
+        wfa_align_within_memory(wf_aligner, target + i, target_length,
+                                query + j, query_length, max_memory);
 
     aln.ok = status == WF_ALIGN_SUCCESSFUL && wf_aligner->cigar.score < max_score;
     if (aln.ok) {
@@ -855,7 +1262,7 @@ void do_wfa_patch_alignment(const char *query, const uint64_t &j,
     }
 
     if (big_wave) {
-        wfa::wavefront_aligner_delete(wf_aligner);
+        release_wavefront_aligner(wf_aligner);
     }
 }
 
@@ -1063,6 +1470,13 @@ bool validate_trace(const std::vector<char> &tracev, const char *query,
     return ok;
 }
 
+bool validate_trace(const rle_cigar_t &tracev, const char *query,
+                    const char *target, const uint64_t &query_aln_len,
+                    const uint64_t &target_aln_len, uint64_t j, uint64_t i) {
+    return validate_trace(tracev.expand(), query, target, query_aln_len,
+                          target_aln_len, j, i);
+}
+
 bool unpack_display_cigar(const wfa::cigar_t &cigar, const char *query,
                           const char *target, const uint64_t &query_aln_len,
                           const uint64_t &target_aln_len, uint64_t j,
@@ -1143,6 +1557,9 @@ void write_merged_alignment(
     const uint64_t &wflign_max_len_major, const uint64_t &wflign_max_len_minor,
     const uint16_t &erode_k,
     const int &min_wf_length, const int &max_dist_threshold,
+    const uint64_t &wflign_max_memory,
+    task_pool_t *const task_pool,
+    merged_alignment_t *const result,
     const bool &with_endline) {
 
     int64_t target_pointer_shift = 0;
@@ -1151,7 +1568,7 @@ void write_merged_alignment(
 
     // patching parameters
     // we will nibble patching back to this length
-    const uint64_t min_wfa_patch_length = 128;
+    const uint64_t min_wfa_patch_length = MIN_WFA_PATCH_LENGTH;
 
     // we need to get the start position in the query and target
     // then run through the whole alignment building up the cigar
@@ -1159,19 +1576,10 @@ void write_merged_alignment(
     // our final cigar
     //
     // std::string cigarstr;
-    uint64_t matches = 0;
-    uint64_t mismatches = 0;
-    uint64_t insertions = 0;
-    uint64_t inserted_bp = 0;
-    uint64_t deletions = 0;
-    uint64_t deleted_bp = 0;
     uint64_t query_start = 0;
     uint64_t target_start = 0;
-    uint64_t total_query_aligned_length = 0;
-    uint64_t total_target_aligned_length = 0;
     uint64_t query_end = 0;
     uint64_t target_end = 0;
-    uint64_t total_score = 0;
 
     // double mash_dist_sum = 0;
     uint64_t ok_alns = 0;
@@ -1182,8 +1590,8 @@ void write_merged_alignment(
     std::cerr << "[wflign::wflign_affine_wavefront] processing traceback"
               << std::endl;
 #endif
-    // write trace into single cigar vector
-    std::vector<char> tracev;
+    // write trace into single cigar stream
+    rle_cigar_t tracev;
     {
         // patch: walk the cigar, patching directly when we have simultaneous
         // gaps in query and ref and adding our results to the final trace as we
@@ -1192,7 +1600,7 @@ void write_merged_alignment(
 #define MAX_NUM_INDELS_TO_LOOK_AT 3
         auto distance_close_big_enough_indels =
             [](const uint32_t indel_len, auto iterator,
-               const std::vector<char> &trace) {
+               const rle_cigar_t &trace) {
                 const uint32_t min_indel_len_to_find = indel_len / 3;
                 const uint16_t max_dist_to_look_at =
                     std::min(indel_len * 64, (uint32_t)4096);//std::numeric_limits<uint16_t>::max());
@@ -1215,10 +1623,11 @@ void write_merged_alignment(
                        dist_close_indels < max_dist_to_look_at) {
                     curr_size_close_indel = 0;
                     while (q != trace.end() && (*q == 'I' || *q == 'D')) {
-                        ++curr_size_close_indel;
+                        const uint64_t n = q.remaining();
+                        curr_size_close_indel += n;
 
-                        ++dist_close_indels;
-                        ++q;
+                        dist_close_indels += n;
+                        q.advance(n);
                     }
                     // std::cerr << "\t\tcurr_size_close_indel " <<
                     // curr_size_close_indel << std::endl;
@@ -1233,8 +1642,9 @@ void write_merged_alignment(
                     while (q != trace.end() &&
                            (dist_close_indels < max_dist_to_look_at) &&
                            *q != 'I' && *q != 'D') {
-                        ++dist_close_indels;
-                        ++q;
+                        const uint64_t n = std::min(q.remaining(), (uint64_t)(max_dist_to_look_at - dist_close_indels));
+                        dist_close_indels += n;
+                        q.advance(n);
                     }
                 }
 
@@ -1246,18 +1656,151 @@ void write_merged_alignment(
                            : -1;
             };
 
+        // patch alignments only depend on the sequences they cover, so they
+        // are memoized by region. The walk below is sequential (each patch
+        // decides where the next one starts), so it is first run speculatively:
+        // regions it has no alignment for are recorded and treated as
+        // unaligned, the recorded regions are then aligned concurrently, and
+        // the walk is repeated until it needs nothing new. That last walk only
+        // used real alignments, so the result is the same as patching serially
+        enum patch_kind_t { patch_middle, patch_head, patch_tail };
+        struct patch_region_t {
+            patch_kind_t kind;
+            const char *query;
+            uint64_t query_length;
+            const char *target;
+            uint64_t target_length;
+            bool operator<(const patch_region_t &other) const {
+                return std::tie(kind, query, query_length, target, target_length)
+                    < std::tie(other.kind, other.query, other.query_length,
+                               other.target, other.target_length);
+            }
+        };
+        struct patch_result_t {
+            bool ok = false;
+            std::string ops; // cigar order
+        };
+        std::map<patch_region_t, patch_result_t> patch_cache;
+        std::vector<patch_region_t> patch_misses;
+        const patch_result_t no_patch;
+        bool speculate = false;
+
+        auto align_patch = [&](const patch_region_t &region,
+                               wfa::wavefront_aligner_t *const patch_wf_aligner) {
+            patch_result_t patch;
+            if (region.kind == patch_middle) {
+                alignment_t patch_aln;
+                // WFA is only global
+                do_wfa_patch_alignment(
+                    region.query, 0, region.query_length,
+                    region.target, 0, region.target_length, segment_length,
+                    min_wf_length, max_dist_threshold,
+                    patch_wf_aligner, affine_penalties,
+                    wflign_max_memory, patch_aln);
+                if (patch_aln.ok) {
+                    patch.ok = true;
+                    patch.ops.assign(patch_aln.edit_cigar.operations + patch_aln.edit_cigar.begin_offset,
+                                     patch_aln.edit_cigar.operations + patch_aln.edit_cigar.end_offset);
+                }
+                return patch;
+            }
+
+            // Semi-global mode for patching the heads (aligned backward) and the tails
+            std::string query_seq(region.query, region.query_length);
+            std::string target_seq(region.target, region.target_length);
+            if (region.kind == patch_head) {
+                std::reverse(query_seq.begin(), query_seq.end());
+                std::reverse(target_seq.begin(), target_seq.end());
+            }
+            wfa::wavefront_aligner_t* const wf_aligner_ends
+                    = get_wavefront_aligner(*affine_penalties,
+                                            target_seq.size()+1,
+                                            query_seq.size()+1, true);
+            wavefront_aligner_set_alignment_free_ends(
+                    wf_aligner_ends,
+                    0,
+                    0,
+                    0,
+                    query_seq.size());
+            wfa::wavefront_reduction_set_adaptive(&wf_aligner_ends->reduction,
+                                                  min_wf_length,
+                                                  max_dist_threshold);
+            const int status =
+                    wfa::wavefront_align(wf_aligner_ends, target_seq.c_str(), target_seq.size(),
+                                         query_seq.c_str(), query_seq.size());
+            if (status == WF_ALIGN_SUCCESSFUL) {
+#ifdef VALIDATE_WFA_WFLIGN
+                if (!validate_cigar(wf_aligner_ends->cigar, query_seq.c_str(), target_seq.c_str(), query_seq.size(),
+                                    target_seq.size(), 0, 0)) {
+                    std::cerr << "cigar failure at " << (region.kind == patch_head ? "head" : "tail") << " alignment " << std::endl;
+                    unpack_display_cigar(wf_aligner_ends->cigar, query_seq.c_str(), target_seq.c_str(), query_seq.size(),
+                                         target_seq.size(), 0, 0);
+                    std::cerr << ">query" << std::endl
+                              << query_seq << std::endl;
+                    std::cerr << ">target" << std::endl
+                              << target_seq << std::endl;
+                    assert(false);
+                }
+#endif
+                patch.ok = true;
+                patch.ops.assign(wf_aligner_ends->cigar.operations + wf_aligner_ends->cigar.begin_offset,
+                                 wf_aligner_ends->cigar.operations + wf_aligner_ends->cigar.end_offset);
+            }
+            release_wavefront_aligner(wf_aligner_ends);
+            return patch;
+        };
+
+        auto get_patch = [&](const patch_region_t &region) -> const patch_result_t & {
+            auto f = patch_cache.find(region);
+            if (f != patch_cache.end()) {
+                return f->second;
+            }
+            if (speculate) {
+                patch_misses.push_back(region);
+                return no_patch;
+            }
+            return patch_cache.emplace(region, align_patch(region, wf_aligner)).first->second;
+        };
+
+        // align the regions on the task pool; the helpers use an aligner of
+        // their own, configured as the one we were given
+        auto align_patches = [&](std::vector<patch_region_t> &regions) {
+            std::sort(regions.begin(), regions.end());
+            regions.erase(std::unique(regions.begin(), regions.end(),
+                                      [](const patch_region_t &a, const patch_region_t &b) {
+                                          return !(a < b) && !(b < a);
+                                      }),
+                          regions.end());
+            std::vector<patch_result_t> results(regions.size());
+            const std::thread::id caller = std::this_thread::get_id();
+            const std::function<void(const uint64_t &)> align_region = [&](const uint64_t &r) {
+                const bool on_caller = std::this_thread::get_id() == caller;
+                wfa::wavefront_aligner_t* const patch_wf_aligner = on_caller ? wf_aligner
+                    : get_wavefront_aligner(*affine_penalties,
+                                            segment_length,
+                                            segment_length,
+                                            wf_aligner->wf_components.bt_piggyback);
+                results[r] = align_patch(regions[r], patch_wf_aligner);
+                if (!on_caller) {
+                    release_wavefront_aligner(patch_wf_aligner);
+                }
+            };
+            task_pool->run(regions.size(), align_region);
+            for (uint64_t r = 0; r < regions.size(); ++r) {
+                patch_cache.emplace(regions[r], std::move(results[r]));
+            }
+        };
+
         auto patching = [&query, &query_name, &query_length, &query_start,
                          &query_offset, &target, &target_name,
                          &target_length_mut, &target_start, &target_offset,
                          &target_total_length, &target_end,
                          &target_pointer_shift,
-                         &segment_length,
                          &wflign_max_len_major,
                          &wflign_max_len_minor,
-                         &distance_close_big_enough_indels, &min_wf_length,
-                         &max_dist_threshold, &wf_aligner,
-                         &affine_penalties](std::vector<char> &unpatched,
-                                            std::vector<char> &patched) {
+                         &distance_close_big_enough_indels,
+                         &get_patch](const rle_cigar_t &unpatched,
+                                            rle_cigar_t &patched) {
             auto q = unpatched.begin();
 
             uint64_t query_pos = query_start;
@@ -1272,12 +1815,14 @@ void write_merged_alignment(
             {
                 // how long a gap?
                 while (q != unpatched.end() && *q == 'I') {
-                    ++query_delta;
-                    ++q;
+                    const uint64_t n = q.remaining();
+                    query_delta += n;
+                    q.advance(n);
                 }
                 while (q != unpatched.end() && *q == 'D') {
-                    ++target_delta;
-                    ++q;
+                    const uint64_t n = q.remaining();
+                    target_delta += n;
+                    q.advance(n);
                 }
 
                 if (query_delta > 0 && query_delta < wflign_max_len_minor) {
@@ -1384,40 +1929,10 @@ void write_merged_alignment(
 //                                << target_delta_x
 //                                << std::endl;
 
-                        std::string query_rev(query + query_pos, query_delta);
-                        std::reverse(query_rev.begin(), query_rev.end());
-
-                        std::string target_rev(target - target_pointer_shift_x +
-                                                   target_pos_x,
-                                               target_delta_x);
-                        std::reverse(target_rev.begin(), target_rev.end());
-
-//                        std::cerr << "query: ";
-//                        for (int i = 0; i < query_delta; ++i) {
-//                            std::cerr << query_rev[i];
-//                        }
-//                        std::cerr << "\ntarget: ";;
-//                        for (int i = 0; i < target_delta_x; ++i) {
-//                            std::cerr << target_rev[i];
-//                        }
-//                        std::cerr << std::endl;
-
-                        wfa::wavefront_aligner_t* const wf_aligner_heads
-                                = get_wavefront_aligner(*affine_penalties,
-                                                        target_rev.size()+1,
-                                                        query_rev.size()+1, true);
-                        wavefront_aligner_set_alignment_free_ends(
-                                wf_aligner_heads,
-                                0,
-                                0,
-                                0,
-                                query_rev.size());
-                        wfa::wavefront_reduction_set_adaptive(&wf_aligner_heads->reduction,
-                                                              min_wf_length,
-                                                              max_dist_threshold);
-                        const int status =
-                                wfa::wavefront_align(wf_aligner_heads, target_rev.c_str(), target_rev.size(),
-                                                     query_rev.c_str(), query_rev.size());
+                        const patch_result_t &head = get_patch(
+                                {patch_head,
+                                 query + query_pos, query_delta,
+                                 target - target_pointer_shift_x + target_pos_x, target_delta_x});
 
                         /*auto result = do_edlib_patch_alignment(
                             query_rev.c_str(), 0, query_rev.size(),
@@ -1426,23 +1941,7 @@ void write_merged_alignment(
                         if (result.status == EDLIB_STATUS_OK &&
                             result.alignmentLength != 0 &&
                             result.editDistance >= 0) {*/
-                        if (status == WF_ALIGN_SUCCESSFUL) {
-                            //hack_cigar(wf_aligner_heads->cigar, query_rev.c_str(), target_rev.c_str(), query_rev.size(), target_rev.size(), 0, 0);
-
-#ifdef VALIDATE_WFA_WFLIGN
-                            if (!validate_cigar(wf_aligner_heads->cigar, query_rev.c_str(), target_rev.c_str(), query_rev.size(),
-                                                target_rev.size(), 0, 0)) {
-                                std::cerr << "cigar failure at head alignment " << std::endl;
-                                unpack_display_cigar(wf_aligner_heads->cigar, query_rev.c_str(), target_rev.c_str(), query_rev.size(),
-                                                     target_rev.size(), 0, 0);
-                                std::cerr << ">query" << std::endl
-                                          << std::string(query_rev.c_str(), query_rev.size()) << std::endl;
-                                std::cerr << ">target" << std::endl
-                                          << std::string(target_rev.c_str(), target_rev.size()) << std::endl;
-                                assert(false);
-                            }
-#endif
-
+                        if (head.ok) {
                             //std::cerr << "Head patching\n";
                             got_alignment = true;
 
@@ -1453,11 +1952,10 @@ void write_merged_alignment(
                             target_start = target_start_x;
                             target_length_mut += target_delta_to_shift;
 
-                            for(int xxx = wf_aligner_heads->cigar.end_offset - 1; xxx >= wf_aligner_heads->cigar.begin_offset; --xxx) {
-                                //std::cerr << wf_aligner_heads->cigar.operations[xxx];
-                                patched.push_back(wf_aligner_heads->cigar.operations[xxx]);
+                            // the head was aligned backward
+                            for (auto op = head.ops.rbegin(); op != head.ops.rend(); ++op) {
+                                patched.push_back(*op);
                             }
-                            //std::cerr << "\n";
 
                             /*
                             // edlib patching
@@ -1483,18 +1981,13 @@ void write_merged_alignment(
                             */
                         }
                         //edlibFreeAlignResult(result);
-                        wfa::wavefront_aligner_delete(wf_aligner_heads);
                     }
                 }
 
                 // add in stuff if we didn't align
                 if (!got_alignment) {
-                    for (uint64_t i = 0; i < query_delta; ++i) {
-                        patched.push_back('I');
-                    }
-                    for (uint64_t i = 0; i < target_delta; ++i) {
-                        patched.push_back('D');
-                    }
+                    patched.push_back('I', query_delta);
+                    patched.push_back('D', target_delta);
                 }
 
                 query_pos += query_delta;
@@ -1509,13 +2002,11 @@ void write_merged_alignment(
             // alignment tips
             while (q != unpatched.end()) {
                 while (q != unpatched.end() && (*q == 'M' || *q == 'X')) {
-                    /*
-                    std::cerr << "q: " << query[query_pos] << " "
-                    << "t: " << target[target_pos - target_pointer_shift] <<
-                    std::endl;
-                    */
-                    if (query_pos >= query_length ||
-                        target_pos >= target_length_mut) {
+                    // copy the whole run, checking it base by base
+                    const char op = *q;
+                    const uint64_t n = q.remaining();
+                    if (query_pos + n > query_length ||
+                        target_pos + n > target_length_mut) {
                         std::cerr << "[wflign::wflign_affine_wavefront] "
                                      "corrupted traceback (out of bounds) for "
                                   << query_name << " " << query_offset << " "
@@ -1524,23 +2015,14 @@ void write_merged_alignment(
                         exit(1);
                     }
 
-                    if (*q == 'M') {
-                        if (query[query_pos] !=
-                            target[target_pos - target_pointer_shift]) {
-                            std::cerr << "[wflign::wflign_affine_wavefront] "
-                                         "corrupted traceback (M, but there is "
-                                         "a mismatch) for "
-                                      << query_name << " " << query_offset
-                                      << " " << target_name << " "
-                                      << target_offset << std::endl;
-                            exit(1);
-                        }
-                    } else {
-                        if (query[query_pos] ==
-                            target[target_pos - target_pointer_shift]) {
+                    const char *q_run = query + query_pos;
+                    const char *t_run = target + target_pos - target_pointer_shift;
+                    for (uint64_t x = 0; x < n; ++x) {
+                        if ((q_run[x] == t_run[x]) != (op == 'M')) {
                             std::cerr << "[wflign::wflign_affine_wavefront] "
-                                         "corrupted traceback (X, but there is "
-                                         "a match) for "
+                                      << (op == 'M'
+                                          ? "corrupted traceback (M, but there is a mismatch) for "
+                                          : "corrupted traceback (X, but there is a match) for ")
                                       << query_name << " " << query_offset
                                       << " " << target_name << " "
                                       << target_offset << std::endl;
@@ -1548,20 +2030,22 @@ void write_merged_alignment(
                         }
                     }
 
-                    patched.push_back(*q);
-                    ++query_pos;
-                    ++target_pos;
-                    ++q;
+                    patched.push_back(op, n);
+                    query_pos += n;
+                    target_pos += n;
+                    q.advance(n);
                 }
 
                 // how long a gap?
                 while (q != unpatched.end() && *q == 'I') {
-                    ++query_delta;
-                    ++q;
+                    const uint64_t n = q.remaining();
+                    query_delta += n;
+                    q.advance(n);
                 }
                 while (q != unpatched.end() && *q == 'D') {
-                    ++target_delta;
-                    ++q;
+                    const uint64_t n = q.remaining();
+                    target_delta += n;
+                    q.advance(n);
                 }
 
                 // how long was our last gap?
@@ -1799,27 +2283,19 @@ void write_merged_alignment(
                             // (to avoid trace-back errors), it must be at least
                             // 10 nt
                             if (query_delta >= 10 && target_delta >= 10) {
-                                alignment_t patch_aln;
-                                // WFA is only global
-                                do_wfa_patch_alignment(
-                                    query, query_pos, query_delta,
-                                    target - target_pointer_shift, target_pos,
-                                    target_delta, segment_length,
-                                    min_wf_length, max_dist_threshold,
-                                    wf_aligner, affine_penalties, patch_aln);
-                                if (patch_aln.ok) {
+                                const patch_result_t &patch = get_patch(
+                                    {patch_middle,
+                                     query + query_pos, query_delta,
+                                     target - target_pointer_shift + target_pos, target_delta});
+                                if (patch.ok) {
                                     // std::cerr << "got an ok patch aln" <<
                                     // std::endl;
                                     got_alignment = true;
-                                    const int start_idx =
-                                        patch_aln.edit_cigar.begin_offset;
-                                    const int end_idx =
-                                        patch_aln.edit_cigar.end_offset;
+                                    const int start_idx = 0;
+                                    const int end_idx = patch.ops.size();
                                     for (int i = start_idx; i < end_idx; i++) {
-                                        // std::cerr <<
-                                        // patch_aln.edit_cigar.operations[i];
-                                        patched.push_back(
-                                            patch_aln.edit_cigar.operations[i]);
+                                        // std::cerr << patch.ops[i];
+                                        patched.push_back(patch.ops[i]);
                                     }
                                     // std::cerr << "\n";
 
@@ -1828,12 +2304,9 @@ void write_merged_alignment(
                                     uint32_t size_indel = 0;
                                     for (int i = end_idx - 1; i >= start_idx;
                                          --i) {
-                                        // std::cerr <<
-                                        // patch_aln.edit_cigar.operations[i];
-                                        if (patch_aln.edit_cigar
-                                                    .operations[i] == 'I' ||
-                                            patch_aln.edit_cigar
-                                                    .operations[i] == 'D') {
+                                        // std::cerr << patch.ops[i];
+                                        if (patch.ops[i] == 'I' ||
+                                            patch.ops[i] == 'D') {
                                             ++size_indel;
                                             ++size_region_to_repatch;
                                         } else {
@@ -1870,12 +2343,8 @@ void write_merged_alignment(
 
                     // add in stuff if we didn't align
                     if (!got_alignment) {
-                        for (uint64_t i = 0; i < query_delta; ++i) {
-                            patched.push_back('I');
-                        }
-                        for (uint64_t i = 0; i < target_delta; ++i) {
-                            patched.push_back('D');
-                        }
+                        patched.push_back('I', query_delta);
+                        patched.push_back('D', target_delta);
                     }
 
                     // std::cerr << "query_delta " << query_delta << std::endl;
@@ -1969,22 +2438,10 @@ void write_merged_alignment(
 //                                  << target_delta_x
 //                                  << std::endl;
 
-                        wfa::wavefront_aligner_t* const wf_aligner_tails
-                                = get_wavefront_aligner(*affine_penalties,
-                                                        target_delta_x+1,
-                                                        query_delta+1, true);
-                        wavefront_aligner_set_alignment_free_ends(
-                                wf_aligner_tails,
-                                0,
-                                0,
-                                0,
-                                query_delta);
-                        wfa::wavefront_reduction_set_adaptive(&wf_aligner_tails->reduction,
-                                                              min_wf_length,
-                                                              max_dist_threshold);
-                        const int status =
-                                wfa::wavefront_align(wf_aligner_tails, target - target_pointer_shift + target_pos, target_delta_x,
-                                                     query + query_pos, query_delta);
+                        const patch_result_t &tail = get_patch(
+                                {patch_tail,
+                                 query + query_pos, query_delta,
+                                 target - target_pointer_shift + target_pos, target_delta_x});
 
                         /*auto result = do_edlib_patch_alignment(
                             query, query_pos, query_delta,
@@ -1993,23 +2450,7 @@ void write_merged_alignment(
                         if (result.status == EDLIB_STATUS_OK &&
                             result.alignmentLength != 0 &&
                             result.editDistance >= 0) {*/
-                        if (status == WF_ALIGN_SUCCESSFUL) {
-                            //hack_cigar(wf_aligner_tails->cigar, query + query_pos, target - target_pointer_shift + target_pos, query_delta, target_delta_x, 0, 0);
-
-#ifdef VALIDATE_WFA_WFLIGN
-                            if (!validate_cigar(wf_aligner_tails->cigar, query + query_pos, target - target_pointer_shift + target_pos, query_delta,
-                                                target_delta_x, 0, 0)) {
-                                std::cerr << "cigar failure at head alignment " << std::endl;
-                                unpack_display_cigar(wf_aligner_tails->cigar, query + query_pos, target - target_pointer_shift + target_pos, query_delta,
-                                                     target_delta_x, 0, 0);
-                                std::cerr << ">query" << std::endl
-                                          << std::string(query + query_pos, query_delta) << std::endl;
-                                std::cerr << ">target" << std::endl
-                                          << std::string(target - target_pointer_shift + target_pos, target_delta_x) << std::endl;
-                                assert(false);
-                            }
-#endif
-
+                        if (tail.ok) {
                             //std::cerr << "Tail patching\n";
                             got_alignment = true;
 
@@ -2028,9 +2469,8 @@ void write_merged_alignment(
 
                             target_delta = target_delta_x;
 
-                            for(int xxx = wf_aligner_tails->cigar.begin_offset; xxx < wf_aligner_tails->cigar.end_offset; ++xxx) {
-                                //std::cerr << wf_aligner_tails->cigar.operations[xxx];
-                                patched.push_back(wf_aligner_tails->cigar.operations[xxx]);
+                            for (const auto &op : tail.ops) {
+                                patched.push_back(op);
                             }
                             //std::cerr << "\n";
 
@@ -2059,18 +2499,13 @@ void write_merged_alignment(
                         }
 
                         //edlibFreeAlignResult(result);
-                        wfa::wavefront_aligner_delete(wf_aligner_tails);
                     }
                 }
 
                 if (!got_alignment) {
                     // add in our tail gap / softclip
-                    for (uint64_t i = 0; i < query_delta; ++i) {
-                        patched.push_back('I');
-                    }
-                    for (uint64_t i = 0; i < target_delta; ++i) {
-                        patched.push_back('D');
-                    }
+                    patched.push_back('I', query_delta);
+                    patched.push_back('D', target_delta);
                 }
                 // query_pos += query_delta; // not used
                 // target_pos += target_delta;
@@ -2086,11 +2521,34 @@ void write_merged_alignment(
 #endif
         };
 
-        std::vector<char> pre_tracev;
+        // a few speculative walks resolve the patches that do not depend on
+        // each other, the rest are aligned in the final (serial) walk
+        const int max_speculative_patching_rounds = 4;
+        auto patching_concurrently = [&](const rle_cigar_t &unpatched, rle_cigar_t &patched) {
+            // the walk moves the target boundaries, undo that between rounds
+            const auto target_state = std::make_tuple(target_start, target_end,
+                                                      target_pointer_shift, target_length_mut);
+            for (int round = 0; ; ++round) {
+                speculate = task_pool != nullptr && task_pool->num_idle() > 0
+                    && round < max_speculative_patching_rounds;
+                patch_misses.clear();
+                rle_cigar_t walked(patched);
+                patching(unpatched, walked);
+                if (patch_misses.empty()) {
+                    patched = std::move(walked);
+                    break;
+                }
+                std::tie(target_start, target_end, target_pointer_shift, target_length_mut) = target_state;
+                align_patches(patch_misses);
+            }
+            speculate = false;
+        };
+
+        rle_cigar_t pre_tracev;
         {
-            std::vector<char> erodev;
+            rle_cigar_t erodev;
             {
-                std::vector<char> rawv;
+                rle_cigar_t rawv;
 
                 // copy
 #ifdef WFLIGN_DEBUG
@@ -2107,16 +2565,10 @@ void write_merged_alignment(
                         }
                         ++ok_alns;
                         if (query_end && aln.j > query_end) {
-                            const int len = aln.j - query_end;
-                            for (uint64_t i = 0; i < len; ++i) {
-                                rawv.push_back('I');
-                            }
+                            rawv.push_back('I', aln.j - query_end);
                         }
                         if (target_end && aln.i > target_end) {
-                            const int len = aln.i - target_end;
-                            for (uint64_t i = 0; i < len; ++i) {
-                                rawv.push_back('D');
-                            }
+                            rawv.push_back('D', aln.i - target_end);
                         }
                         uint64_t target_aligned_length = 0;
                         uint64_t query_aligned_length = 0;
@@ -2177,26 +2629,30 @@ void write_merged_alignment(
                           << erode_k << std::endl;
 #endif
 
-                // erode by removing matches < k
-                for (uint64_t i = 0; i < rawv.size();) {
-                    if (rawv[i] == 'M' || rawv[i] == 'X') {
-                        uint64_t j = i;
-                        while (++j < rawv.size() &&
-                               (rawv[j] == 'M' || rawv[j] == 'X')) {
+                // erode by removing matches < k; the eroded matches become
+                // Ds and Is, which sort_indels groups right after
+                const auto &raw_runs = rawv.runs();
+                for (uint64_t x = 0; x < raw_runs.size();) {
+                    if (raw_runs[x].op == 'M' || raw_runs[x].op == 'X') {
+                        uint64_t y = x;
+                        uint64_t len = 0;
+                        while (y < raw_runs.size() &&
+                               (raw_runs[y].op == 'M' || raw_runs[y].op == 'X')) {
+                            len += raw_runs[y++].len;
                         }
-                        if (j - i < erode_k) {
-                            while (i < j) {
-                                erodev.push_back('D');
-                                erodev.push_back('I');
-                                ++i;
-                            }
+                        if (len < erode_k) {
+                            erodev.push_back('D', len);
+                            erodev.push_back('I', len);
                         } else {
-                            while (i < j) {
-                                erodev.push_back(rawv[i++]);
+                            while (x < y) {
+                                erodev.push_back(raw_runs[x].op, raw_runs[x].len);
+                                ++x;
                             }
                         }
+                        x = y;
                     } else {
-                        erodev.push_back(rawv[i++]);
+                        erodev.push_back(raw_runs[x].op, raw_runs[x].len);
+                        ++x;
                     }
                 }
             }
@@ -2230,7 +2686,7 @@ void write_merged_alignment(
 #endif
 
             // normalize: sort so that I<D and otherwise leave it as-is
-            sort_indels(erodev);
+            erodev.sort_indels();
 
 #ifdef WFLIGN_DEBUG
             std::cerr << "[wflign::wflign_affine_wavefront] got normalized "
@@ -2243,7 +2699,7 @@ void write_merged_alignment(
 
             // std::cerr << "FIRST PATCH ROUND
             // +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++\n";
-            patching(erodev, pre_tracev);
+            patching_concurrently(erodev, pre_tracev);
 
 #ifdef VALIDATE_WFA_WFLIGN
             if (!validate_trace(pre_tracev, query,
@@ -2268,17 +2724,17 @@ void write_merged_alignment(
 #endif
 
             // normalize: sort so that I<D and otherwise leave it as-is
-            sort_indels(pre_tracev);
+            pre_tracev.sort_indels();
         }
 
         // std::cerr << "SECOND PATCH ROUND
         // +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++\n";
-        patching(pre_tracev, tracev);
+        patching_concurrently(pre_tracev, tracev);
     }
 
     // std::cerr << "sorting the indels in tracev" << std::endl;
     // normalize the indels
-    sort_indels(tracev);
+    tracev.sort_indels();
 
 #ifdef WFLIGN_DEBUG
     std::cerr
@@ -2320,32 +2776,21 @@ void write_merged_alignment(
     uint64_t trim_del_last = 0;
     {
         // 1.) sort initial ins/del to put del < ins
-        auto first_non_indel = tracev.begin();
-        while (first_non_indel != tracev.end() &&
-               (*first_non_indel == 'D' || *first_non_indel == 'I')) {
-            ++first_non_indel;
-        }
-        std::sort(tracev.begin(), first_non_indel,
-                  [](char a, char b) { return a < b; });
-        // 2.) find first non-D in tracev --> tracev_begin
+        tracev.sort_leading_indels();
+        // 2.) count the Ds at the start of tracev
         //   a.) add to target_start this count
-        auto first_non_del = tracev.begin();
-        while (first_non_del != tracev.end() && *first_non_del == 'D') {
-            ++first_non_del;
-        }
-        trim_del_first = std::distance(tracev.begin(), first_non_del);
+        trim_del_first = tracev.leading('D');
         target_start += trim_del_first;
         // target_length_mut -= trim_del_first;
 
-        // 3.) count D's at end of tracev --> tracev_end
+        // 3.) count D's at end of tracev
         //   b.) subtract from target_end this count
-        auto last_non_del = tracev.rbegin();
-        while (last_non_del != tracev.rend() && *last_non_del == 'D') {
-            ++last_non_del;
-        }
-        trim_del_last = std::distance(tracev.rbegin(), last_non_del);
+        trim_del_last = tracev.trailing('D');
         target_end -= trim_del_last;
         // target_length_mut -= trim_del_last;
+
+        tracev.trim(trim_del_first,
+                    trim_del_first == tracev.size() ? 0 : trim_del_last);
     }
 
     /*
@@ -2369,9 +2814,123 @@ query_start : query_end)
 #endif
     */
 
-    // convert trace to cigar, get correct start and end coordinates
-    char *cigarv = alignment_to_cigar(
-        tracev, trim_del_first, tracev.size() - trim_del_last,
+    merged_alignment_t merged;
+    merged_alignment_t &aln = result != nullptr ? *result : merged;
+    aln.emitted = true;
+    aln.tracev = std::move(tracev);
+    aln.query_start = query_start;
+    aln.query_end = query_end;
+    aln.target_start = (int64_t)target_start - target_pointer_shift;
+    aln.target_end = target_end;
+    aln.elapsed_time_wflambda_ms = elapsed_time_wflambda_ms;
+    aln.elapsed_time_patching_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time)
+            .count();
+    aln.num_alignments = num_alignments;
+    aln.num_alignments_performed = num_alignments_performed;
+
+    write_merged_alignment_record(
+        out, aln, emit_md_tag, paf_format_else_sam,
+        query, query_name, query_total_length,
+        query_offset, query_length, query_is_rev,
+        target, target_name, target_total_length, target_offset,
+        min_identity, mashmap_estimated_identity);
+}
+
+bool wavefront_info_to_tsv(const char *data, const uint64_t &size, std::ostream &out) {
+    uint64_t p = 0;
+    auto get_varint = [&](uint64_t &x) {
+        x = 0;
+        for (int shift = 0; p < size && shift < 64; shift += 7) {
+            const uint8_t b = data[p++];
+            x |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    };
+    auto get_string = [&](std::string &s) {
+        uint64_t n;
+        if (!get_varint(n) || n > size - p) {
+            return false;
+        }
+        s.assign(data + p, n);
+        p += n;
+        return true;
+    };
+
+    std::string query_name, target_name;
+    uint64_t query_start, query_end, target_start, target_end;
+    if (!(get_string(query_name) && get_varint(query_start) && get_varint(query_end)
+          && get_string(target_name) && get_varint(target_start) && get_varint(target_end))) {
+        return false;
+    }
+    out << "# query_name=" << query_name << "\n"
+        << "# query_start=" << query_start << "\n"
+        << "# query_end=" << query_end << "\n"
+        << "# target_name=" << target_name << "\n"
+        << "# target_start=" << target_start << "\n"
+        << "# target_end=" << target_end << "\n"
+        << "# info: 0) mismatch, mash-distance > threshold; 1) mismatch, WFA-score >= max_score; 2) match, WFA-score < max_score" << "\n"
+        << "v" << "\t" << "h" << "\t" << "info" << "\n";
+
+    int64_t v = 0;
+    int64_t h = 0;
+    while (p < size) {
+        uint64_t a, b;
+        if (!get_varint(a) || !get_varint(b)) {
+            return false;
+        }
+        const int info = a & 3;
+        if (a & 4) {
+            v = a >> 3;
+            h = b;
+        } else {
+            const uint64_t zv = a >> 3;
+            v += (int64_t)(zv >> 1) ^ -(int64_t)(zv & 1);
+            h += (int64_t)(b >> 1) ^ -(int64_t)(b & 1);
+        }
+        out << v << "\t" << h << "\t" << info << "\n";
+    }
+    return true;
+}
+
+void write_merged_alignment_record(
+    std::ostream &out, const merged_alignment_t &aln,
+    const bool &emit_md_tag, const bool &paf_format_else_sam,
+    const char *query, const std::string &query_name,
+    const uint64_t &query_total_length,
+    const uint64_t &query_offset, const uint64_t &query_length,
+    const bool &query_is_rev, const char *target,
+    const std::string &target_name, const uint64_t &target_total_length,
+    const uint64_t &target_offset,
+    const float &min_identity, const float &mashmap_estimated_identity) {
+    if (!aln.emitted) {
+        return;
+    }
+
+    const auto &tracev = aln.tracev;
+    const uint64_t &query_start = aln.query_start;
+    const uint64_t &query_end = aln.query_end;
+    const uint64_t &target_end = aln.target_end;
+
+    uint64_t matches = 0;
+    uint64_t mismatches = 0;
+    uint64_t insertions = 0;
+    uint64_t inserted_bp = 0;
+    uint64_t deletions = 0;
+    uint64_t deleted_bp = 0;
+    uint64_t total_query_aligned_length = 0;
+    uint64_t total_target_aligned_length = 0;
+
+    // convert trace to cigar (and MD string), get correct start and end coordinates
+    char_buffer_t cigarv;
+    char_buffer_t mdv;
+    trace_to_cigar_and_md(
+        tracev, target + aln.target_start, emit_md_tag,
+        cigarv, mdv,
         total_target_aligned_length, total_query_aligned_length, matches,
         mismatches, insertions, inserted_bp, deletions, deleted_bp);
 
@@ -2385,89 +2944,12 @@ query_start : query_end)
     const double block_identity =
         (double)matches / (double)(matches + edit_distance);
 
-    auto write_tag_and_md_string = [&](std::ostream &out, const char *c,
-                                       const int target_start) {
-        out << "MD:Z:";
-
-        char last_op = '\0';
-        int last_len = 0;
-        int t_off = target_start, l_MD = 0;
-        int l = 0;
-        int x = 0;
-        while (c[x] != '\0') {
-            while (isdigit(c[x]))
-                ++x;
-            char op = c[x];
-            int len = 0;
-            std::from_chars(c + l, c + x, len);
-            l = ++x;
-            if (last_len) {
-                if (last_op == op) {
-                    len += last_len;
-                } else {
-                    // std::cerr << t_off << "   " << last_len << last_op <<
-                    // std::endl;
-
-                    if (last_op == '=') {
-                        l_MD += last_len;
-                        t_off += last_len;
-                    } else if (last_op == 'X') {
-                        for (uint64_t ii = 0; ii < last_len; ++ii) {
-                            out << l_MD
-                                << target[t_off + ii - target_pointer_shift];
-                            l_MD = 0;
-                        }
-
-                        t_off += last_len;
-                    } else if (last_op == 'D') {
-                        out << l_MD << "^";
-                        for (uint64_t ii = 0; ii < last_len; ++ii) {
-                            out << target[t_off + ii - target_pointer_shift];
-                        }
-
-                        l_MD = 0;
-                        t_off += last_len;
-                    }
-                }
-            }
-            last_op = op;
-            last_len = len;
-        }
-
-        if (last_len) {
-            // std::cerr << t_off << "   " << last_len << last_op << std::endl;
-
-            if (last_op == '=') {
-                out << last_len + l_MD;
-            } else if (last_op == 'X') {
-                for (uint64_t ii = 0; ii < last_len; ++ii) {
-                    out << l_MD << target[t_off + ii - target_pointer_shift];
-                    l_MD = 0;
-                }
-                out << "0";
-            } else if (last_op == 'I') {
-                out << l_MD;
-            } else if (last_op == 'D') {
-                out << l_MD << "^";
-                for (uint64_t ii = 0; ii < last_len; ++ii) {
-                    out << target[t_off + ii - target_pointer_shift];
-                }
-                out << "0";
-            }
-        }
-    };
-
     if (gap_compressed_identity >= min_identity) {
-        const long elapsed_time_patching_ms =
-            std::chrono::duration_cast<std::chrono::milliseconds>(
-                std::chrono::steady_clock::now() - start_time)
-                .count();
-
         const std::string timings_and_num_alignements =
-            "wt:i:" + std::to_string(elapsed_time_wflambda_ms) +
-            "\tpt:i:" + std::to_string(elapsed_time_patching_ms) +
-            "\taa:i:" + std::to_string(num_alignments) +
-            "\tap:i:" + std::to_string(num_alignments_performed);
+            "wt:i:" + std::to_string(aln.elapsed_time_wflambda_ms) +
+            "\tpt:i:" + std::to_string(aln.elapsed_time_patching_ms) +
+            "\taa:i:" + std::to_string(aln.num_alignments) +
+            "\tap:i:" + std::to_string(aln.num_alignments_performed);
 
         if (paf_format_else_sam) {
             out << query_name << "\t" << query_total_length << "\t"
@@ -2478,7 +2960,7 @@ query_start : query_end)
                        (query_is_rev ? query_length - query_start : query_end)
                 << "\t" << (query_is_rev ? "-" : "+") << "\t" << target_name
                 << "\t" << target_total_length << "\t"
-                << target_offset - target_pointer_shift + target_start << "\t"
+                << target_offset + aln.target_start << "\t"
                 << target_offset + target_end << "\t" << matches << "\t"
                 << std::max(total_target_aligned_length,
                             total_query_aligned_length)
@@ -2500,13 +2982,14 @@ query_start : query_end)
                 << "md:f:" << mashmap_estimated_identity;
 
             if (emit_md_tag) {
-                out << "\t";
-
-                write_tag_and_md_string(out, cigarv, target_start);
+                out << "\tMD:Z:";
+                out.write(mdv.data(), mdv.size());
             }
 
             out << "\t" << timings_and_num_alignements << "\t"
-                << "cg:Z:" << cigarv << "\n";
+                << "cg:Z:";
+            out.write(cigarv.data(), cigarv.size());
+            out << "\n";
         } else {
             const uint64_t query_start_pos =
                 query_offset +
@@ -2519,7 +3002,7 @@ query_start : query_end)
                 << "\t" << (query_is_rev ? "16" : "0") // bitwise FLAG
                 << "\t" << target_name // Reference sequence NAME
                 << "\t"
-                << target_offset - target_pointer_shift + target_start +
+                << target_offset + aln.target_start +
                        1 // 1-based leftmost mapping POSition
                 << "\t"
                 << std::round(
@@ -2536,7 +3019,7 @@ query_start : query_end)
                     out << query_start_pos << "S";
                 }
             }
-            out << cigarv;
+            out.write(cigarv.data(), cigarv.size());
             if (query_is_rev) {
                 if (query_start_pos > 0) {
                     out << query_start_pos << "S";
@@ -2556,9 +3039,7 @@ query_start : query_end)
                 << "\t";
 
             // segment SEQuence
-            for (uint64_t p = 0; p < query_length; ++p) {
-                out << query[p];
-            }
+            out.write(query, query_length);
 
             out << "\t"
                 << "*" // ASCII of Phred-scaled base QUALity+33
@@ -2580,17 +3061,13 @@ query_start : query_end)
                 << "";
 
             if (emit_md_tag) {
-                out << "\t";
-
-                write_tag_and_md_string(out, cigarv, target_start);
+                out << "\tMD:Z:";
+                out.write(mdv.data(), mdv.size());
             }
 
             out << "\t" << timings_and_num_alignements << "\n";
         }
     }
-
-    // always clean up
-    free(cigarv);
 }
 
 void write_alignment(
@@ -2678,79 +3155,96 @@ void write_alignment(
     }
 }
 
-char *alignment_to_cigar(const std::vector<char> &edit_cigar,
-                         const uint64_t &start_idx, const uint64_t &end_idx,
-                         uint64_t &target_aligned_length,
-                         uint64_t &query_aligned_length, uint64_t &matches,
-                         uint64_t &mismatches, uint64_t &insertions,
-                         uint64_t &inserted_bp, uint64_t &deletions,
-                         uint64_t &deleted_bp) {
-
-    // the edit cigar contains a character string of ops
-    // here we compress them into the standard cigar representation
+void trace_to_cigar_and_md(const rle_cigar_t &edit_cigar,
+                           const char *target, const bool &emit_md,
+                           char_buffer_t &cigar, char_buffer_t &md,
+                           uint64_t &target_aligned_length,
+                           uint64_t &query_aligned_length, uint64_t &matches,
+                           uint64_t &mismatches, uint64_t &insertions,
+                           uint64_t &inserted_bp, uint64_t &deletions,
+                           uint64_t &deleted_bp) {
+
+    // the runs of the edit cigar are already the blocks of the standard cigar
+    // representation; target points to the first aligned target base
+    const auto &runs = edit_cigar.runs();
+    cigar.reserve(runs.size() * 8);
+    uint64_t l_md = 0; // matches not yet written to the MD string
+
+    for (std::size_t x = 0; x < runs.size(); ++x) {
+        const auto &run = runs[x];
+        const bool last = x + 1 == runs.size();
+
+        // calculate matches, mismatches, insertions, deletions
+        switch (run.op) {
+        case 'M':
+            matches += run.len;
+            query_aligned_length += run.len;
+            target_aligned_length += run.len;
+            break;
+        case 'X':
+            mismatches += run.len;
+            query_aligned_length += run.len;
+            target_aligned_length += run.len;
+            break;
+        case 'I':
+            ++insertions;
+            inserted_bp += run.len;
+            query_aligned_length += run.len;
+            break;
+        case 'D':
+            ++deletions;
+            deleted_bp += run.len;
+            target_aligned_length += run.len;
+            break;
+        default:
+            break;
+        }
 
-    auto *cigar = new std::vector<char>();
-    char lastMove = 0; // Char of last move. 0 if there was no previous move.
-    int numOfSameMoves = 0;
+        // reassign 'M' to '=' for convenience
+        cigar.append(run.len);
+        cigar.append(run.op == 'M' ? '=' : run.op);
 
-    // std::cerr << "start to end " << start_idx << " " << end_idx << std::endl;
-    for (int i = start_idx; i <= end_idx; i++) {
-        // if new sequence of same moves started
-        if (i == end_idx || (edit_cigar[i] != lastMove && lastMove != 0)) {
-            // calculate matches, mismatches, insertions, deletions
-            switch (lastMove) {
+        if (emit_md) {
+            switch (run.op) {
             case 'M':
-                matches += numOfSameMoves;
-                query_aligned_length += numOfSameMoves;
-                target_aligned_length += numOfSameMoves;
+                if (last) {
+                    md.append(run.len + l_md);
+                } else {
+                    l_md += run.len;
+                }
+                target += run.len;
                 break;
             case 'X':
-                mismatches += numOfSameMoves;
-                query_aligned_length += numOfSameMoves;
-                target_aligned_length += numOfSameMoves;
+                for (uint64_t ii = 0; ii < run.len; ++ii) {
+                    md.append(l_md);
+                    md.append(target[ii]);
+                    l_md = 0;
+                }
+                if (last) {
+                    md.append('0');
+                }
+                target += run.len;
                 break;
             case 'I':
-                ++insertions;
-                inserted_bp += numOfSameMoves;
-                query_aligned_length += numOfSameMoves;
+                if (last) {
+                    md.append(l_md);
+                }
                 break;
             case 'D':
-                ++deletions;
-                deleted_bp += numOfSameMoves;
-                target_aligned_length += numOfSameMoves;
+                md.append(l_md);
+                md.append('^');
+                md.append(target, run.len);
+                if (last) {
+                    md.append('0');
+                }
+                l_md = 0;
+                target += run.len;
                 break;
             default:
                 break;
             }
-
-            // Write number of moves to cigar string.
-            int numDigits = 0;
-            for (; numOfSameMoves; numOfSameMoves /= 10) {
-                cigar->push_back('0' + numOfSameMoves % 10);
-                numDigits++;
-            }
-            std::reverse(cigar->end() - numDigits, cigar->end());
-            // Write code of move to cigar string.
-            // reassign 'M' to '=' for convenience
-            lastMove = lastMove == 'M' ? '=' : lastMove;
-            cigar->push_back(lastMove);
-            // If not at the end, start new sequence of moves.
-            if (i < end_idx) {
-                numOfSameMoves = 0;
-            }
-        }
-        if (i < end_idx) {
-            lastMove = edit_cigar[i];
-            numOfSameMoves++;
         }
     }
-    cigar->push_back(0); // Null character termination.
-
-    char *cigar_ = (char *)malloc(cigar->size() * sizeof(char));
-    std::memcpy(cigar_, &(*cigar)[0], cigar->size() * sizeof(char));
-    delete cigar;
-
-    return cigar_;
 }
 
 char *wfa_alignment_to_cigar(const wfa::cigar_t *const edit_cigar,
@@ -2930,22 +3424,6 @@ void wflign_edit_cigar_copy(wfa::cigar_t *const edit_cigar_dst,
            edit_cigar_dst->end_offset);
 }
 
-void sort_indels(std::vector<char> &v) {
-    auto f = v.begin();
-    while (f != v.end()) {
-        auto j = f;
-        while (j != v.end() && (*j == 'D' || *j == 'I')) {
-            ++j;
-        }
-        if (j != f) {
-            std::sort(f, j, [](char a, char b) { return b < a; });
-            f = j;
-        } else {
-            ++f;
-        }
-    }
-}
-
 } // namespace wavefront
 
 } // namespace wflign
@@ -1,14 +1,28 @@
+#pragma once
+
 #include "WFA/edit/edit_dp.h"
 #include <algorithm>
 #include <cctype>
 #include <charconv>
+#include <climits>
 #include <cmath>
 #include <cstring>
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <list>
 #include <sstream>
 #include <functional>
 #include <fstream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <unordered_map>
+#include <tuple>
 
 //#include "WFA/gap_affine/affine_wavefront.hpp"
 //#include "WFA/gap_affine/affine_wavefront_align.h"
@@ -21,6 +35,7 @@
 
 //#include "wfa_edit_callback.hpp"
 #include "dna.hpp"
+#include "rle_cigar.hpp"
 #include "rkmh.hpp"
 #include "wflambda/utils/commons.h"
 #include "wflambda/gap_affine/affine_matrix.h"
@@ -46,6 +61,10 @@ bool validate_trace(const std::vector<char> &tracev, const char *query,
                     const char *target, const uint64_t &query_aln_len,
                     const uint64_t &target_aln_len, uint64_t j, uint64_t i);
 
+bool validate_trace(const rle_cigar_t &tracev, const char *query,
+                    const char *target, const uint64_t &query_aln_len,
+                    const uint64_t &target_aln_len, uint64_t j, uint64_t i);
+
 bool unpack_display_cigar(const wfa::cigar_t &cigar, const char *query,
                           const char *target, const uint64_t &query_aln_len,
                           const uint64_t &target_aln_len, uint64_t j,
@@ -236,16 +255,460 @@ void edlib_to_wflign_edit_cigar_copy(
     const uint64_t& edlib_cigar_len);
 */
 
+// mappings up to this length (on both axes) are aligned directly with WFA,
+// longer ones go through wflambda
+#define MAX_LEN_FOR_PURE_WFA 50000
+
+// patches are grown up to this length; patching an end of the alignment can
+// then reach up to query length + MIN_WFA_PATCH_LENGTH past the target region
+#define MIN_WFA_PATCH_LENGTH 128
+
+// wavefront information of an alignment (-T), in a compact binary form: a
+// header with the names and coordinates of the mapping, then one entry per
+// evaluated wflambda cell. Numbers are LEB128 varints; a cell is
+// varint(v << 3 | absolute << 2 | info) varint(h), where v and h are deltas
+// (zigzag-encoded) from the previous cell of the stream unless absolute.
+// wavefront_info_to_tsv decodes it into the TSV read by scripts/wfplot.R
+struct wavefront_info_encoder_t {
+    bool started = false;
+    int64_t v = 0;
+    int64_t h = 0;
+
+    static void put_varint(std::ostream &out, uint64_t x) {
+        char buf[10];
+        int n = 0;
+        do {
+            buf[n++] = (char)((x & 0x7f) | (x > 0x7f ? 0x80 : 0));
+            x >>= 7;
+        } while (x != 0);
+        out.write(buf, n);
+    }
+
+    static void put_string(std::ostream &out, const std::string &s) {
+        put_varint(out, s.size());
+        out.write(s.data(), s.size());
+    }
+
+    static void header(std::ostream &out,
+                       const std::string &query_name, const uint64_t &query_start, const uint64_t &query_end,
+                       const std::string &target_name, const uint64_t &target_start, const uint64_t &target_end) {
+        put_string(out, query_name);
+        put_varint(out, query_start);
+        put_varint(out, query_end);
+        put_string(out, target_name);
+        put_varint(out, target_start);
+        put_varint(out, target_end);
+    }
+
+    // info: 0) mismatch, alignment skipped; 1) mismatch, alignment performed; 2) match
+    void cell(std::ostream &out, const int64_t &cell_v, const int64_t &cell_h, const int &info) {
+        if (!started) {
+            put_varint(out, (uint64_t)cell_v << 3 | 4 | info);
+            put_varint(out, cell_h);
+            started = true;
+        } else {
+            const int64_t dv = cell_v - v;
+            const int64_t dh = cell_h - h;
+            put_varint(out, ((uint64_t)dv << 1 ^ (uint64_t)(dv >> 63)) << 3 | info);
+            put_varint(out, (uint64_t)dh << 1 ^ (uint64_t)(dh >> 63));
+        }
+        v = cell_v;
+        h = cell_h;
+    }
+};
+
+// write the TSV of the wavefront information of an alignment; false if the data is malformed
+bool wavefront_info_to_tsv(const char *data, const uint64_t &size, std::ostream &out);
+
+// a merged alignment, as written out by write_merged_alignment: kept apart
+// from its formatting so that it can be stored and written again, possibly
+// with other output options. Coordinates are relative to the query (on the
+// strand of the mapping) and target regions of the mapping
+struct merged_alignment_t {
+    bool emitted = false; // false if no record is written for the mapping
+    rle_cigar_t tracev;
+    uint64_t query_start = 0;
+    uint64_t query_end = 0;
+    int64_t target_start = 0; // negative if the head was patched before the target region
+    uint64_t target_end = 0;
+    long elapsed_time_wflambda_ms = 0;
+    long elapsed_time_patching_ms = 0;
+    uint64_t num_alignments = 0;
+    uint64_t num_alignments_performed = 0;
+};
+
+// the sketches of the segments of one sequence, shared by all the alignments
+// against it (possibly running on different threads). Segments are keyed by
+// their forward-strand position: the kmer hashes are canonical, so a segment
+// and its reverse complement have the same sketch. Only the most recently used
+// sketches are kept; their bytes are added to accounted_bytes, if given
+struct segment_sketch_cache_t {
+    static constexpr std::size_t max_sketches = 1 << 16;
+
+    struct key_t {
+        uint64_t offset;
+        uint64_t params; // kmer size, segment length, sketch size
+        bool operator==(const key_t& other) const {
+            return offset == other.offset && params == other.params;
+        }
+    };
+    struct key_hash_t {
+        std::size_t operator()(const key_t& key) const {
+            return std::hash<uint64_t>()(key.offset * 0x9E3779B97F4A7C15ULL ^ key.params);
+        }
+    };
+    struct entry_t {
+        key_t key;
+        std::vector<rkmh::hash_t> sketch;
+    };
+    std::mutex mutex;
+    std::list<entry_t> entries; // most recently used first
+    std::unordered_map<key_t, std::list<entry_t>::iterator, key_hash_t> sketches;
+    std::atomic<uint64_t>* const accounted_bytes;
+    uint64_t bytes = 0;
+
+    explicit segment_sketch_cache_t(std::atomic<uint64_t>* const accounted_bytes = nullptr)
+        : accounted_bytes(accounted_bytes) {}
+    ~segment_sketch_cache_t() {
+        if (accounted_bytes != nullptr) {
+            *accounted_bytes -= bytes;
+        }
+    }
+
+    static key_t key(const uint64_t& offset, const uint64_t& kmer_size,
+                     const uint64_t& segment_length, const uint64_t& sketch_size) {
+        return {offset, kmer_size << 32 | segment_length << 16 | sketch_size};
+    }
+    // what an entry takes, with its list and map nodes (roughly)
+    static uint64_t entry_bytes(const uint64_t& size) {
+        return sizeof(entry_t) + sizeof(key_t) + 6 * sizeof(void*) + size * sizeof(rkmh::hash_t);
+    }
+    // copy the sketch into sketch (room for the sketch size in the key)
+    bool get(const key_t& key, rkmh::hash_t* sketch, uint64_t& size) {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto f = sketches.find(key);
+        if (f == sketches.end()) {
+            return false;
+        }
+        entries.splice(entries.begin(), entries, f->second);
+        std::copy(f->second->sketch.begin(), f->second->sketch.end(), sketch);
+        size = f->second->sketch.size();
+        return true;
+    }
+    void put(const key_t& key, const rkmh::hash_t* sketch, const uint64_t& size) {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (sketches.find(key) != sketches.end()) {
+            return; // another alignment got there first
+        }
+        entries.push_front({key, std::vector<rkmh::hash_t>(sketch, sketch + size)});
+        sketches.emplace(key, entries.begin());
+        int64_t delta = entry_bytes(size);
+        if (entries.size() > max_sketches) {
+            const entry_t& last = entries.back();
+            delta -= entry_bytes(last.sketch.size());
+            sketches.erase(last.key);
+            entries.pop_back();
+        }
+        bytes += delta;
+        if (accounted_bytes != nullptr) {
+            *accounted_bytes += delta;
+        }
+    }
+};
+
+// the kmer hashes along one side of a wflambda alignment and the bottom-k
+// sketches of its (overlapping) segments, sliced from them the first time a
+// segment is compared (and it is not in the cache). Both are computed in blocks
+// of consecutive segments, and only the most recently used blocks are kept, so
+// memory is bounded however long the region is
+struct segment_sketches_t {
+    static constexpr uint64_t block_segments = 64;
+    static constexpr uint64_t max_blocks = 16;
+
+    struct block_t {
+        uint64_t index;
+        uint64_t last_use;
+        std::vector<rkmh::hash_t> kmer_hashes;
+        std::vector<rkmh::hash_t> sketches;
+        std::vector<int32_t> sketch_sizes; // -1 if not computed yet
+    };
+    const char* seq;
+    const uint64_t length;
+    const uint64_t num_segments;
+    const uint16_t segment_length;
+    const uint16_t step_size;
+    const uint64_t kmer_size;
+    const uint64_t stride; // room for the sketch of the (longer) last segment
+    segment_sketch_cache_t* const cache;
+    // forward-strand position of the start (end, if reversed) of seq
+    const uint64_t cache_origin;
+    const bool cache_is_rev;
+    std::vector<block_t> blocks;
+    uint64_t uses = 0;
+    std::vector<rkmh::hash_t> buffer;
+
+    segment_sketches_t(const char* seq, const uint64_t& length,
+                       const uint64_t& num_segments,
+                       const uint16_t& segment_length,
+                       const uint16_t& step_size,
+                       const uint64_t& kmer_size,
+                       segment_sketch_cache_t* const cache = nullptr,
+                       const uint64_t& cache_origin = 0,
+                       const bool& cache_is_rev = false)
+        : seq(seq), length(length),
+          num_segments(num_segments), segment_length(segment_length),
+          step_size(step_size), kmer_size(kmer_size),
+          stride((2 * (uint64_t)segment_length) / 20),
+          cache(cache), cache_origin(cache_origin), cache_is_rev(cache_is_rev) {
+        blocks.reserve(max_blocks);
+    }
+
+    // the block holding segment s, recycling the least recently used one if
+    // too many are kept; its kmer hashes are computed on first use
+    block_t& block(const uint64_t& s) {
+        const uint64_t index = s / block_segments;
+        block_t* found = nullptr;
+        for (auto& b : blocks) {
+            if (b.index == index) {
+                found = &b;
+                break;
+            }
+        }
+        if (found == nullptr) {
+            if (blocks.size() < max_blocks) {
+                blocks.emplace_back();
+                found = &blocks.back();
+            } else {
+                found = &*std::min_element(blocks.begin(), blocks.end(),
+                                           [](const block_t& a, const block_t& b) {
+                                               return a.last_use < b.last_use;
+                                           });
+            }
+            found->index = index;
+            found->kmer_hashes.clear();
+            found->sketches.resize(block_segments * stride);
+            found->sketch_sizes.assign(block_segments, -1);
+        }
+        found->last_use = ++uses;
+        return *found;
+    }
+
+    const rkmh::hash_t* get(const uint64_t& s, const uint64_t& segment_length,
+                            uint64_t& sketch_size) {
+        block_t& b = block(s);
+        const uint64_t slot = s % block_segments;
+        rkmh::hash_t* const sketch = b.sketches.data() + slot * stride;
+        if (b.sketch_sizes[slot] < 0) {
+            const uint64_t begin = s * step_size;
+            const uint64_t max_sketch_size = std::min(segment_length / 20, stride);
+            segment_sketch_cache_t::key_t key{};
+            if (cache != nullptr) {
+                key = segment_sketch_cache_t::key(
+                        cache_is_rev ? cache_origin - begin - segment_length : cache_origin + begin,
+                        kmer_size, segment_length, max_sketch_size);
+                uint64_t cached_size;
+                if (cache->get(key, sketch, cached_size)) {
+                    b.sketch_sizes[slot] = cached_size;
+                    sketch_size = cached_size;
+                    return sketch;
+                }
+            }
+            // the block covers its segments, the last one of the region
+            // running to its end
+            const uint64_t block_begin = b.index * block_segments * step_size;
+            if (b.kmer_hashes.empty()) {
+                const uint64_t last = std::min((b.index + 1) * block_segments, num_segments) - 1;
+                const uint64_t block_end = last == num_segments - 1
+                        ? length
+                        : std::min(length, last * step_size + this->segment_length);
+                b.kmer_hashes = rkmh::hash_kmers(seq + block_begin, block_end - block_begin, kmer_size);
+            }
+            const uint64_t num_kmers = segment_length >= kmer_size ? segment_length - kmer_size + 1 : 0;
+            b.sketch_sizes[slot] = rkmh::sketch_kmers(b.kmer_hashes.data() + begin - block_begin, num_kmers,
+                                                      max_sketch_size,
+                                                      buffer, sketch);
+            if (cache != nullptr) {
+                cache->put(key, sketch, b.sketch_sizes[slot]);
+            }
+        }
+        sketch_size = b.sketch_sizes[slot];
+        return sketch;
+    }
+};
+
+// the wflambda cells evaluated so far, stored densely along each diagonal
+// (h - v) from the first to the last cell touched on it, so memory follows the
+// band explored by the wavefront; the alignments of matching cells live in a
+// slab and are referenced by index
+struct wflambda_cells_t {
+    static constexpr uint32_t unevaluated = 0;
+    static constexpr uint32_t mismatch = 1;
+
+    struct diagonal_t {
+        int v_begin = 0;
+        std::vector<uint32_t> cells;
+    };
+    const int pattern_length;
+    std::vector<diagonal_t> diagonals;
+    std::deque<alignment_t> slab;
+
+    wflambda_cells_t(const int& pattern_length, const int& text_length)
+        : pattern_length(pattern_length),
+          diagonals(std::max(pattern_length + text_length - 1, 0)) {}
+
+    uint32_t& operator()(const int& v, const int& h) {
+        diagonal_t& diagonal = diagonals[h - v + pattern_length - 1];
+        if (diagonal.cells.empty()) {
+            diagonal.v_begin = v;
+        } else if (v < diagonal.v_begin) {
+            diagonal.cells.insert(diagonal.cells.begin(), diagonal.v_begin - v, unevaluated);
+            diagonal.v_begin = v;
+        }
+        if (v - diagonal.v_begin >= (int)diagonal.cells.size()) {
+            diagonal.cells.resize(v - diagonal.v_begin + 1, unevaluated);
+        }
+        return diagonal.cells[v - diagonal.v_begin];
+    }
+
+    uint32_t get(const int& v, const int& h) const {
+        const diagonal_t& diagonal = diagonals[h - v + pattern_length - 1];
+        const int x = v - diagonal.v_begin;
+        return x >= 0 && x < (int)diagonal.cells.size() ? diagonal.cells[x] : unevaluated;
+    }
+
+    alignment_t* alignment(const uint32_t& cell) {
+        return &slab[cell - 2];
+    }
+
+    uint32_t add_alignment() {
+        slab.emplace_back();
+        return slab.size() + 1;
+    }
+
+    // move an alignment out of the slab, for the trace to own it
+    static alignment_t* release(alignment_t* const aln) {
+        auto* released = new alignment_t(*aln);
+        aln->edit_cigar.operations = nullptr;
+        return released;
+    }
+};
+
+// work shared by all the alignments of a run, for the parts an alignment can
+// split (the chunks of a long mapping, its patches). The pool has no threads
+// of its own: the thread handing over a job works on it, and the align workers
+// that are out of mappings help with it, so the run never uses more threads
+// than it was given. A job is never stuck behind the jobs of other threads
+class task_pool_t {
+public:
+    // threads currently waiting in help_until for a job
+    int num_idle() const { return idle.load(); }
+
+    // run task(i) for every i in [0, n), on the calling thread and on the idle
+    // helpers, and return once all of them are done
+    void run(const uint64_t &n, const std::function<void(const uint64_t &)> &task) {
+        auto job = std::make_shared<job_t>(n, task);
+        if (n > 1) {
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                jobs.push_back(job);
+            }
+            todo_cv.notify_all();
+        }
+        work(*job);
+        std::unique_lock<std::mutex> lock(mutex);
+        jobs.erase(std::remove(jobs.begin(), jobs.end(), job), jobs.end());
+        done_cv.wait(lock, [&]() { return job->done == job->n; });
+    }
+
+    // work on a job handed over by another thread, if there is one; returns
+    // whether there was
+    bool help() {
+        std::shared_ptr<job_t> job;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            while (!jobs.empty() && jobs.front()->next.load() >= jobs.front()->n) {
+                // all handed out, its caller waits for the last ones
+                jobs.pop_front();
+            }
+            if (jobs.empty()) {
+                return false;
+            }
+            job = jobs.front();
+        }
+        work(*job);
+        return true;
+    }
+
+    // help with the jobs of the other threads until finished() holds
+    void help_until(const std::function<bool()> &finished) {
+        ++idle;
+        while (!finished()) {
+            if (help()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            todo_cv.wait_for(lock, std::chrono::milliseconds(1), [&]() { return !jobs.empty(); });
+        }
+        --idle;
+    }
+
+private:
+    struct job_t {
+        const uint64_t n;
+        const std::function<void(const uint64_t &)> &task;
+        std::atomic<uint64_t> next{0};
+        uint64_t done = 0; // guarded by the pool mutex
+        job_t(const uint64_t &n, const std::function<void(const uint64_t &)> &task)
+            : n(n), task(task) {}
+    };
+
+    std::deque<std::shared_ptr<job_t>> jobs;
+    std::mutex mutex;
+    std::condition_variable todo_cv;
+    std::condition_variable done_cv;
+    std::atomic<int> idle{0};
+
+    void work(job_t &job) {
+        uint64_t i;
+        while ((i = job.next.fetch_add(1)) < job.n) {
+            job.task(i);
+            bool last;
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                last = ++job.done == job.n;
+            }
+            if (last) {
+                done_cv.notify_all();
+            }
+        }
+    }
+};
+
 inline uint64_t encode_pair(int v, int h) {
     return ((uint64_t)v << 32) | (uint64_t)h;
 }
 
+// aligners are pooled per thread and keyed by penalties and memory mode: an
+// aligner handed back with release_*_aligner is reset and reused by the next
+// matching get_*_aligner call on the same thread, instead of being reallocated
+// for every mapping, patch and head/tail extension
 wfa::wavefront_aligner_t* get_wavefront_aligner(
     const wfa::affine_penalties_t& wfa_affine_penalties,
     const uint64_t& target_length,
     const uint64_t& query_length,
     const bool& low_memory);
 
+void release_wavefront_aligner(wfa::wavefront_aligner_t* const wf_aligner);
+
+wflambda::wavefront_aligner_t* get_wflambda_aligner(
+    const wflambda::affine_penalties_t& wflambda_affine_penalties,
+    const int& min_wavefront_length,
+    const int& max_distance_threshold,
+    const int& pattern_length,
+    const int& text_length);
+
+void release_wflambda_aligner(wflambda::wavefront_aligner_t* const wflambda_aligner);
+
 void wflign_affine_wavefront(
     std::ostream &out,
     const bool &emit_tsv, std::ostream &out_tsv,
@@ -268,15 +731,52 @@ void wflign_affine_wavefront(
     const int &wflign_gap_extension_score,
     const float &wflign_max_mash_dist,
     const uint64_t &wflign_max_len_major, const uint64_t &wflign_max_len_minor,
-    const uint16_t &erode_k);
+    const uint16_t &erode_k,
+    const uint64_t &wflign_chunk_length, const uint64_t &wflign_max_memory,
+    task_pool_t *const task_pool = nullptr,
+    segment_sketch_cache_t *const query_sketch_cache = nullptr,
+    merged_alignment_t *const result = nullptr);
 // const int& wfa_min_wavefront_length, // with these set at 0 we do exact WFA
 // for WFA itself const int& wfa_max_distance_threshold);
 
+// score above which no alignment of sequences of these lengths can
+// reach min_identity (gap-compressed); INT_MAX without an identity threshold
+int wfa_identity_score_bound(const float &min_identity,
+                             const uint64_t &query_length,
+                             const uint64_t &target_length,
+                             const wfa::affine_penalties_t &penalties);
+
+void do_wflambda_alignment(
+    std::vector<alignment_t *> &trace,
+    uint64_t &num_alignments, uint64_t &num_alignments_performed,
+    const bool &emit_tsv, std::ostream &out_tsv,
+    const std::string &query_name, const char *query,
+    const uint64_t &chunk_query_begin, const uint64_t &query_length,
+    const std::string &target_name, const char *target,
+    const uint64_t &chunk_target_begin, const uint64_t &target_length,
+    const uint16_t &segment_length_to_use, const uint16_t &step_size,
+    const int &minhash_kmer_size,
+    const int &wflambda_min_wavefront_length,
+    const int &wflambda_max_distance_threshold,
+    const float &max_mash_dist_to_evaluate, const float &mashmap_estimated_identity,
+    wflambda::affine_penalties_t *const wflambda_affine_penalties,
+    wfa::wavefront_aligner_t *const wf_aligner,
+    wfa::affine_penalties_t *const wfa_affine_penalties,
+    segment_sketch_cache_t *const query_sketch_cache = nullptr,
+    const uint64_t &query_cache_origin = 0, const bool &query_is_rev = false);
+
+// splice the trace of a chunk (in alignment order) onto the trace of the
+// previous, overlapping chunks
+void splice_chunk_traces(std::vector<alignment_t *> &trace,
+                         std::vector<alignment_t *> &chunk_trace,
+                         const uint64_t &chunk_query_begin,
+                         const uint64_t &chunk_target_begin);
+
 bool do_wfa_segment_alignment(
     const std::string &query_name, const char *query,
-    std::vector<rkmh::hash_t> *&query_sketches, const uint64_t &query_length,
+    const rkmh::hash_t *query_sketch, const uint64_t &query_sketch_size,
     const uint64_t &j, const std::string &target_name, const char *target,
-    std::vector<rkmh::hash_t> *&target_sketches, const uint64_t &target_length,
+    const rkmh::hash_t *target_sketch, const uint64_t &target_sketch_size,
     const uint64_t &i,
     const uint16_t &segment_length_q,
     const uint16_t &segment_length_t,
@@ -286,6 +786,15 @@ bool do_wfa_segment_alignment(
     wfa::wavefront_aligner_t *const wf_aligner,
     wfa::affine_penalties_t *const affine_penalties, alignment_t &aln);
 
+// if the two segments are identical, fill aln with the all-match alignment WFA
+// would find and return true, without sketching or aligning them
+bool do_identical_segment_alignment(const char *query, const uint64_t &j,
+                                    const char *target, const uint64_t &i,
+                                    const uint16_t &segment_length_q,
+                                    const uint16_t &segment_length_t,
+                                    const uint64_t &minhash_kmer_size,
+                                    alignment_t &aln);
+
 void do_wfa_patch_alignment(const char *query, const uint64_t &j,
                             const uint64_t &query_length, const char *target,
                             const uint64_t &i, const uint64_t &target_length,
@@ -294,8 +803,16 @@ void do_wfa_patch_alignment(const char *query, const uint64_t &j,
                             const int &max_distance_threshold,
                             wfa::wavefront_aligner_t *const wf_aligner,
                             wfa::affine_penalties_t *const affine_penalties,
+                            const uint64_t &max_memory,
                             alignment_t &aln);
 
+// align with the regular WFA while it stays within max_memory bytes (0 for no
+// limit); past that, redo the alignment with the linear-memory bidirectional WFA
+int wfa_align_within_memory(wfa::wavefront_aligner_t *const wf_aligner,
+                            const char *pattern, const int &pattern_length,
+                            const char *text, const int &text_length,
+                            const uint64_t &max_memory);
+
 //EdlibAlignResult do_edlib_patch_alignment(const char *query, const uint64_t &j,
 //                                          const uint64_t &query_length,
 //                                          const char *target, const uint64_t &i,
@@ -319,8 +836,25 @@ void write_merged_alignment(
     const uint64_t &wflign_max_len_major, const uint64_t &wflign_max_len_minor,
     const uint16_t &erode_k,
     const int &min_wf_length, const int &max_dist_threshold,
+    const uint64_t &wflign_max_memory,
+    task_pool_t *const task_pool,
+    merged_alignment_t *const result = nullptr,
     const bool &with_endline = true);
 
+// write the PAF/SAM record of a merged alignment (nothing if it was not
+// emitted or is below min_identity); query and target point to the regions
+// of the mapping
+void write_merged_alignment_record(
+    std::ostream &out, const merged_alignment_t &aln,
+    const bool &emit_md_tag, const bool &paf_format_else_sam,
+    const char *query, const std::string &query_name,
+    const uint64_t &query_total_length,
+    const uint64_t &query_offset, const uint64_t &query_length,
+    const bool &query_is_rev, const char *target,
+    const std::string &target_name, const uint64_t &target_total_length,
+    const uint64_t &target_offset,
+    const float &min_identity, const float &mashmap_estimated_identity);
+
 void write_alignment(std::ostream &out, const alignment_t &aln,
                      const std::string &query_name,
                      const uint64_t &query_total_length,
@@ -332,13 +866,49 @@ void write_alignment(std::ostream &out, const alignment_t &aln,
                      const float &mashmap_estimated_identity,
                      const bool &with_endline = true);
 
-char *alignment_to_cigar(const std::vector<char> &edit_cigar,
-                         const uint64_t &start_idx, const uint64_t &end_idx,
-                         uint64_t &target_aligned_length,
-                         uint64_t &query_aligned_length, uint64_t &matches,
-                         uint64_t &mismatches, uint64_t &insertions,
-                         uint64_t &inserted_bp, uint64_t &deletions,
-                         uint64_t &deleted_bp);
+// a growable output buffer, formatting integers with std::to_chars
+class char_buffer_t {
+public:
+    const char *data() const { return buf.data(); }
+    std::size_t size() const { return used; }
+    void reserve(const std::size_t &n) {
+        if (buf.size() < n) buf.resize(n);
+    }
+    void append(const char &c) {
+        *room(1) = c;
+        ++used;
+    }
+    void append(const char *s, const std::size_t &n) {
+        std::memcpy(room(n), s, n);
+        used += n;
+    }
+    void append(const uint64_t &v) {
+        char *p = room(20);
+        used = std::to_chars(p, p + 20, v).ptr - buf.data();
+    }
+
+private:
+    std::vector<char> buf;
+    std::size_t used = 0;
+    char *room(const std::size_t &n) {
+        if (used + n > buf.size()) {
+            buf.resize(std::max(2 * buf.size(), used + n));
+        }
+        return buf.data() + used;
+    }
+};
+
+// in a single pass over the trace, count the alignment statistics and write
+// the CIGAR and (if emit_md) the MD string; target points to the first
+// aligned target base
+void trace_to_cigar_and_md(const rle_cigar_t &edit_cigar,
+                           const char *target, const bool &emit_md,
+                           char_buffer_t &cigar, char_buffer_t &md,
+                           uint64_t &target_aligned_length,
+                           uint64_t &query_aligned_length, uint64_t &matches,
+                           uint64_t &mismatches, uint64_t &insertions,
+                           uint64_t &inserted_bp, uint64_t &deletions,
+                           uint64_t &deleted_bp);
 
 char *wfa_alignment_to_cigar(const wfa::cigar_t *const edit_cigar,
                              uint64_t &target_aligned_length,
@@ -361,8 +931,6 @@ char *wfa_alignment_to_cigar(const wfa::cigar_t *const edit_cigar,
 
 double float2phred(const double &prob);
 
-void sort_indels(std::vector<char> &v);
-
 } // namespace wavefront
 
 } // namespace wflign
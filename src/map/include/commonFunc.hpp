@@ -19,8 +19,6 @@
 #include "common/murmur3.h"
 #include "common/prettyprint.hpp"
 
-#include "common/wflign/src/rkmh.hpp"
-
 namespace skch {
     /**
      * @namespace skch::CommonFunc
@@ -59,6 +57,24 @@ namespace skch {
             }
         }
 
+        // non-zero for everything but the canonical DNA bases (either case)
+        static const int valid_dna[127] = {
+                1,
+                1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 1, 0, 1, 0, 1, 1, 1,
+                0, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 0, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 1, 1, 1, 0, 1, 0, 1,
+                1, 1, 0, 1, 1, 1, 1, 1, 1, 1,
+                1, 1, 1, 1, 1, 0, 1, 1, 1, 1,
+                1, 1, 1, 1, 1, 1
+        };
+
         /**
      * @brief               convert DNA or AA alphabets to upper case, converting non-canonical DNA bases to N
      * @param[in]   seq     pointer to input sequence
@@ -70,7 +86,7 @@ namespace skch {
                     seq[i] -= 32;
                 }
 
-                if (rkmh::valid_dna[seq[i]]) {
+                if (valid_dna[seq[i]]) {
                     seq[i] = 'N';
                 }
             }
@@ -96,7 +112,7 @@ namespace skch {
 //         */
 //        inline void makeValidDNA(char *seq, offset_t len) {
 //            for (int i = 0; i < len; i++) {
-//                if (rkmh::valid_dna[seq[i]]) {
+//                if (valid_dna[seq[i]]) {
 //                    seq[i] = 'N';
 //                }
 //            }
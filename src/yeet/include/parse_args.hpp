@@ -86,6 +86,10 @@ void parse_args(int argc,
                                             {'g', "wfa-params"});
     args::ValueFlag<int> wflambda_min_wavefront_length(parser, "N", "minimum wavefront length (width) to trigger reduction [default: 100]", {'A', "wflamda-min"});
     args::ValueFlag<std::string> wflambda_max_distance_threshold(parser, "N", "maximum distance (in base-pairs) that a wavefront may be behind the best wavefront (1k = 1K = 1000, 1m = 1M = 10^6, 1g = 1G = 10^9) [default: 100000]", {'D', "wflambda-diff"});
+    args::ValueFlag<uint64_t> align_lookahead(parser, "N", "dispatch the most expensive alignments first within windows of this many mappings (1 = input order) [default: 4096]", {"align-lookahead"});
+    args::ValueFlag<std::string> align_max_inflight_bytes(parser, "N", "memory budget of the query sequences and target regions held by the mappings waiting to be (or being) aligned, and of the alignments waiting to be written in input order; past it, reading the input waits for the alignments; 0 disables (1k = 1K = 1000, 1m = 1M = 10^6, 1g = 1G = 10^9) [default: 4g]", {"align-queue-mem"});
+    args::ValueFlag<std::string> align_shard(parser, "i/N", "split the input mappings into N shards of similar estimated alignment cost and align only shard i (0-based); only the sequences of that shard are loaded", {"align-shard"});
+    args::ValueFlag<std::string> align_cache_dir(parser, "DIR", "reuse the alignments of the mappings already aligned (same sequences, coordinates and alignment parameters) by the runs sharing this cache directory, and add the new ones to it", {"align-cache"});
 
     //Unsupported
     //args::Flag exact_wflambda(parser, "N", "compute the exact wflambda, don't use adaptive wavefront reduction", {'xxx', "exact-wflambda"});
@@ -100,10 +104,15 @@ void parse_args(int argc,
     args::ValueFlag<std::string> wflign_max_len_major(parser, "N", "maximum length to patch in the major axis (1k = 1K = 1000, 1m = 1M = 10^6, 1g = 1G = 10^9) [default: 512*segment-length]", {'C', "max-patch-major"});
     args::ValueFlag<std::string> wflign_max_len_minor(parser, "N", "maximum length to patch in the minor axis (1k = 1K = 1000, 1m = 1M = 10^6, 1g = 1G = 10^9) [default: 128*segment-length]", {'F', "max-patch-minor"});
     args::ValueFlag<uint16_t> wflign_erode_k(parser, "N", "maximum length of match/mismatch islands to erode before patching [default: 13]", {'E', "erode-match-mismatch"});
+    args::ValueFlag<std::string> wflign_chunk_length(parser, "N", "split mappings at least twice this long in chunks, aligned in parallel and then spliced (the alignments near the chunk boundaries may differ from an unchunked run); 0 disables (1k = 1K = 1000, 1m = 1M = 10^6, 1g = 1G = 10^9) [default: 0]", {"wflign-chunk"});
+    args::ValueFlag<std::string> wflign_max_memory(parser, "N", "memory budget of a single WFA alignment (pure WFA and large patches); past it, the alignment is redone with the linear-memory bidirectional WFA; 0 disables (1k = 1K = 1000, 1m = 1M = 10^6, 1g = 1G = 10^9) [default: 1g]", {"wflign-max-mem"});
 
     // format parameters
     args::Flag emit_md_tag(parser, "N", "output the MD tag", {'d', "md-tag"});
     args::Flag sam_format(parser, "N", "output in the SAM format (PAF by default)", {'a', "sam-format"});
+    args::Flag bgzf_output(parser, "", "compress the output (PAF or SAM) in BGZF blocks, in parallel; readable by bgzip, tabix and samtools", {"bgzf"});
+    args::ValueFlag<std::string> output_file(parser, "FILE", "write the output to FILE [default: stdout]", {'o', "output"});
+    args::Flag resume(parser, "", "journal the aligned mappings in FILE.journal next to the output FILE (-o) and, if a journal is already there, skip the mappings aligned by the previous run and append only the new alignments; the journal is synced about once per second, so a crash loses about the last second of alignments", {"resume"});
 
     // general parameters
     args::ValueFlag<std::string> tmp_base(parser, "PATH", "base name for temporary files [default: `pwd`]", {'B', "tmp-base"});
@@ -111,6 +120,7 @@ void parse_args(int argc,
 
     // debugging
     args::ValueFlag<std::string> prefix_wavefront_info_in_tsv(parser, "PREFIX", " write wavefronts' information for each alignment in TSV format files with this PREFIX", {'T', "tsv"});
+    args::Flag tsv_container(parser, "", "with -T, write the wavefront information of all the alignments to PREFIX.wfv (indexed by PREFIX.wfv.idx) instead of one TSV file per alignment; scripts/wfv2tsv.py converts it back to the TSV files", {"tsv-bin"});
 
     //args::Flag show_progress(parser, "show-progress", "write alignment progress to stderr", {'P', "show-progress"});
     //args::Flag verbose_debug(parser, "verbose-debug", "enable verbose debugging", {'V', "verbose-debug"});
@@ -262,6 +272,24 @@ void parse_args(int argc,
         exit(1);
     }
 
+    align_parameters.alignCacheDir = align_cache_dir ? args::get(align_cache_dir) : "";
+
+    align_parameters.bgzf_output = args::get(bgzf_output);
+    if (align_parameters.bgzf_output && args::get(approx_mapping)) {
+        std::cerr << "[wfmash] ERROR, skch::parseandSave, --bgzf compresses the alignments, it cannot be used with -m/--approx-map" << std::endl;
+        exit(1);
+    }
+
+    align_parameters.resume = args::get(resume);
+    if (align_parameters.resume && (!output_file || args::get(approx_mapping))) {
+        std::cerr << "[wfmash] ERROR, skch::parseandSave, --resume needs the alignments to be written to a file (with -o)" << std::endl;
+        exit(1);
+    }
+    if (align_parameters.resume && align_parameters.bgzf_output) {
+        std::cerr << "[wfmash] ERROR, skch::parseandSave, --resume needs an uncompressed output (without --bgzf)" << std::endl;
+        exit(1);
+    }
+
     map_parameters.mergeMappings = !args::get(no_merge);
 
     if (segment_length) {
@@ -440,6 +468,32 @@ void parse_args(int argc,
         align_parameters.wflign_erode_k = map_parameters.percentageIdentity >= 0.97 ? 21 : (map_parameters.percentageIdentity >= 0.9 ? 17 : 13);
     }
 
+    if (wflign_chunk_length) {
+        const int64_t wflign_chunk_length_ = wfmash::handy_parameter(args::get(wflign_chunk_length));
+
+        if (wflign_chunk_length_ < 0) {
+            std::cerr << "[wfmash] ERROR, skch::parseandSave, the chunk length has to be a float value greater than or equal to 0." << std::endl;
+            exit(1);
+        }
+
+        align_parameters.wflign_chunk_length = wflign_chunk_length_;
+    } else {
+        align_parameters.wflign_chunk_length = 0;
+    }
+
+    if (wflign_max_memory) {
+        const int64_t wflign_max_memory_ = wfmash::handy_parameter(args::get(wflign_max_memory));
+
+        if (wflign_max_memory_ < 0) {
+            std::cerr << "[wfmash] ERROR, skch::parseandSave, the WFA memory budget has to be a float value greater than or equal to 0." << std::endl;
+            exit(1);
+        }
+
+        align_parameters.wflign_max_memory = wflign_max_memory_;
+    } else {
+        align_parameters.wflign_max_memory = 1000000000;
+    }
+
     // Unsupported
     //if (exact_wflambda) {
     //    // set exact computation of wflambda
@@ -447,6 +501,53 @@ void parse_args(int argc,
     //    align_parameters.wflambda_max_distance_threshold = 0;
     //}
 
+    if (align_lookahead) {
+        if (args::get(align_lookahead) == 0) {
+            std::cerr << "[wfmash] ERROR, skch::parseandSave, the alignment look-ahead window has to be greater than 0." << std::endl;
+            exit(1);
+        }
+        align_parameters.align_lookahead = args::get(align_lookahead);
+    } else {
+        align_parameters.align_lookahead = 4096;
+    }
+
+    if (align_max_inflight_bytes) {
+        const int64_t align_max_inflight_bytes_ = wfmash::handy_parameter(args::get(align_max_inflight_bytes));
+
+        if (align_max_inflight_bytes_ < 0) {
+            std::cerr << "[wfmash] ERROR, skch::parseandSave, the alignment queue memory budget has to be a float value greater than or equal to 0." << std::endl;
+            exit(1);
+        }
+
+        align_parameters.align_max_inflight_bytes = align_max_inflight_bytes_;
+    } else {
+        align_parameters.align_max_inflight_bytes = 4000000000;
+    }
+
+    if (align_shard) {
+        const std::string shard = args::get(align_shard);
+        const auto slash = shard.find('/');
+        int64_t shard_index = -1;
+        int64_t shard_count = -1;
+        if (slash != std::string::npos) {
+            try {
+                shard_index = std::stoll(shard.substr(0, slash));
+                shard_count = std::stoll(shard.substr(slash + 1));
+            } catch (...) {}
+        }
+
+        if (shard_count <= 0 || shard_index < 0 || shard_index >= shard_count) {
+            std::cerr << "[wfmash] ERROR, skch::parseandSave, the alignment shard has to be given as i/N, with N > 0 and 0 <= i < N." << std::endl;
+            exit(1);
+        }
+
+        align_parameters.align_shard = shard_index;
+        align_parameters.align_shard_count = shard_count;
+    } else {
+        align_parameters.align_shard = 0;
+        align_parameters.align_shard_count = 1;
+    }
+
     if (thread_count) {
         map_parameters.threads = args::get(thread_count);
         align_parameters.threads = args::get(thread_count);
@@ -479,7 +580,7 @@ void parse_args(int argc,
     }
 
     if (approx_mapping) {
-        map_parameters.outFileName = "/dev/stdout";
+        map_parameters.outFileName = output_file ? args::get(output_file) : "/dev/stdout";
         yeet_parameters.approx_mapping = true;
     } else {
         yeet_parameters.approx_mapping = false;
@@ -500,12 +601,25 @@ void parse_args(int argc,
             map_parameters.outFileName = temp_file::create();
             align_parameters.mashmapPafFile = map_parameters.outFileName;
         }
-        align_parameters.pafOutputFile = "/dev/stdout";
+        align_parameters.pafOutputFile = output_file ? args::get(output_file) : "/dev/stdout";
     }
 
     align_parameters.tsvOutputPrefix = (prefix_wavefront_info_in_tsv && !args::get(prefix_wavefront_info_in_tsv).empty())
             ? args::get(prefix_wavefront_info_in_tsv)
             : "";
+    align_parameters.tsvContainer = args::get(tsv_container);
+    if (align_parameters.tsvContainer && align_parameters.tsvOutputPrefix.empty()) {
+        std::cerr << "[wfmash] ERROR, skch::parseandSave, --tsv-bin needs the wavefront information to be written (with -T)" << std::endl;
+        exit(1);
+    }
+    if (!align_parameters.alignCacheDir.empty() && args::get(approx_mapping)) {
+        std::cerr << "[wfmash] ERROR, skch::parseandSave, --align-cache keeps the alignments, it cannot be used with -m/--approx-map" << std::endl;
+        exit(1);
+    }
+    if (!align_parameters.alignCacheDir.empty() && !align_parameters.tsvOutputPrefix.empty()) {
+        std::cerr << "[wfmash] ERROR, skch::parseandSave, --align-cache does not keep the wavefront information, it cannot be used with -T" << std::endl;
+        exit(1);
+    }
 
     if (num_mappings_for_segments) {
         if (args::get(num_mappings_for_segments) > 0) {
@@ -45,6 +45,15 @@ int main(int argc, char **argv) {
     yeet::Parameters yeet_parameters;
     yeet::parse_args(argc, argv, map_parameters, align_parameters, yeet_parameters);
 
+    // a resumed run appends to the output of the previous one, a fresh run replaces it
+    const bool resuming = align_parameters.resume
+            && align::alignment_journal_t::exists(align_parameters.pafOutputFile);
+    if (!yeet_parameters.approx_mapping && !resuming
+        && align_parameters.pafOutputFile != "/dev/stdout") {
+        std::ofstream outstrm(align_parameters.pafOutputFile);
+        std::remove(align::alignment_journal_t::journal_file(align_parameters.pafOutputFile).c_str());
+    }
+
     //parameters.refSequences.push_back(ref);
 
     //skch::parseandSave(argc, argv, cmd, parameters);
@@ -88,12 +97,28 @@ int main(int argc, char **argv) {
             return 0;
         }
 
-        if (align_parameters.sam_format) {
-            std::ofstream outstrm(align_parameters.pafOutputFile);
+        if (align_parameters.sam_format && !resuming) {
+            std::stringstream header;
             for (auto &x : referSketch.metadata) {
-                outstrm << "@SQ\tSN:" << x.name << "\tLN:" << x.len << "\n";
+                header << "@SQ\tSN:" << x.name << "\tLN:" << x.len << "\n";
+            }
+            header << "@PG\tID:wfmash\tPN:wfmash\tVN:0.1\tCL:wfmash\n";
+
+            std::ofstream outstrm(align_parameters.pafOutputFile, std::ios::binary);
+            if (align_parameters.bgzf_output) {
+                // the first blocks of the BGZF output; the align stage appends the rest
+                align::bgzf_compressor_t bgzf(align_parameters.threads);
+                const std::string text = header.str();
+                bgzf.append(text.data(), text.size());
+                bgzf.finish();
+                std::vector<std::string> blocks;
+                bgzf.collect(blocks, true);
+                for (auto &block : blocks) {
+                    outstrm << block;
+                }
+            } else {
+                outstrm << header.rdbuf();
             }
-            outstrm << "@PG\tID:wfmash\tPN:wfmash\tVN:0.1\tCL:wfmash\n";
             outstrm.close();
         }
     } else {